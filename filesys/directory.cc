@@ -24,6 +24,7 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -41,11 +42,10 @@ Directory::Directory(int size)
     tableSize = size;
     for (int i = 0; i < tableSize; i++)
 	table[i].inUse = FALSE;
-    FileHeader *dirHdr = new FileHeader;
-    dirHdr->FetchFrom(1);
-    dirHdr->lastVisitTime = time(NULL);
+    FileHeader *dirHdr = headerTable->Open(1);
+    dirHdr->Visited(1);
     //printf("tt:%s\n", ctime(&(dirHdr->lastVisitTime)));
-    dirHdr->WriteBack(1);
+    headerTable->Close(1);
 }
 
 //----------------------------------------------------------------------
@@ -204,15 +204,15 @@ Directory::List()
 void
 Directory::Print()
 { 
-    FileHeader *hdr = new FileHeader;
+    FileHeader *hdr;
 
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse) {
 	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
+	    hdr = headerTable->Open(table[i].sector);
 	    hdr->Print();
+	    headerTable->Close(table[i].sector);
 	}
     printf("\n");
-    delete hdr;
 }
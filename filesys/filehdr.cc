@@ -27,6 +27,32 @@
 #include "system.h"
 #include "filehdr.h"
 #include <time.h>
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize the in-memory part of a file header; the rest comes
+//	from Allocate or FetchFrom.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    ASSERT((char *) &indexCache - (char *) this == SectorSize);
+    indexCache = NULL;
+    refs = 0;
+    dirty = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the index blocks kept in memory.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    DropIndex();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -73,7 +99,7 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize, int _fileType)
             }
             tempNumSectors -= 32;
         }
-        synchDisk->WriteSector(primaryIndexTable[i], (char *)tempDataSectors);
+        WriteIndex(i, tempDataSectors);
     }
 
     return TRUE;
@@ -91,11 +117,11 @@ FileHeader::ExtendAllocate(BitMap *freeMap, int extraFileSize)
         return true;
     }
     printf("try to allocate more sectors\n");
-    numBytes = numBytes + extraFileSize;
     int extraSectors  = divRoundUp(extraFileSize, SectorSize);
     
     if (freeMap->NumClear() < extraSectors)
-    return FALSE;       // not enough space
+    return FALSE;       // not enough space; the header stays as it was
+    numBytes = numBytes + extraFileSize;
     /*
     for (int i = 0; i < numSectors; i++)
     dataSectors[i] = freeMap->Find();
@@ -111,7 +137,7 @@ FileHeader::ExtendAllocate(BitMap *freeMap, int extraFileSize)
     {
 
         int tempDataSectors[32];
-        synchDisk->ReadSector(primaryIndexTable[initialPrimarytableEntries - 1], (char*)tempDataSectors);
+        ReadIndex(initialPrimarytableEntries - 1, tempDataSectors);
         if(tempNumSectors >= 32 - (initialNumSectors % 32))
         {
             for(int i = initialNumSectors % 32; i < 32; i ++)
@@ -127,7 +153,7 @@ FileHeader::ExtendAllocate(BitMap *freeMap, int extraFileSize)
                 tempDataSectors[i] = freeMap->Find();
             }
         }
-        synchDisk->WriteSector(primaryIndexTable[initialPrimarytableEntries - 1], (char *)tempDataSectors);
+        WriteIndex(initialPrimarytableEntries - 1, tempDataSectors);
     }
 
     for(int i = initialPrimarytableEntries; i < numPrimaryIndexTableEntries; i ++)
@@ -151,7 +177,7 @@ FileHeader::ExtendAllocate(BitMap *freeMap, int extraFileSize)
             }
             tempNumSectors -= 32;
         }
-        synchDisk->WriteSector(primaryIndexTable[i], (char *)tempDataSectors);
+        WriteIndex(i, tempDataSectors);
     }
     numSectors = numSectors + extraSectors;
     printf("current sectors:%d  current bytes:%d\n", numSectors, numBytes);
@@ -177,7 +203,7 @@ FileHeader::Deallocate(BitMap *freeMap)
     for (int i = 0; i < numPrimaryIndexTableEntries; i++) {
 	ASSERT(freeMap->Test((int) primaryIndexTable[i]));  // ought to be marked!
     int tempDataSectors[32];
-    synchDisk->ReadSector(primaryIndexTable[i], (char*)tempDataSectors);
+    ReadIndex(i, tempDataSectors);
     if(tempNumSectors < 32)
     {
 
@@ -198,6 +224,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 
     freeMap->Clear((int) primaryIndexTable[i]);
     }
+    DropIndex();
     
     //printf("try to clear free map\n");
     //freeMap->Print();
@@ -205,7 +232,8 @@ FileHeader::Deallocate(BitMap *freeMap)
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk.  The index blocks in
+//	memory are kept if the file still has the same blocks.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -213,8 +241,18 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+    int oldSectors = numSectors;
+    time_t oldCreateTime = createTime;
+    int oldTable[NumDirect];
+
+    if (indexCache != NULL)
+	bcopy((char *) primaryIndexTable, (char *) oldTable, sizeof(oldTable));
     //printf("FetchFrom sector:%d\n", sector);
     synchDisk->ReadSector(sector, (char *)this);
+    if ((indexCache != NULL) && ((numSectors != oldSectors) ||
+		(createTime != oldCreateTime) || bcmp((char *) oldTable,
+		(char *) primaryIndexTable, sizeof(oldTable))))
+	DropIndex();			// someone else changed the file
    // printf("3\n");
 }
 
@@ -229,6 +267,72 @@ void
 FileHeader::WriteBack(int sector)
 {
     synchDisk->WriteSector(sector, (char *)this); 
+    dirty = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Visited
+// 	Stamp the visit time of a file that was just opened or read, as
+//	far as the time update policy asks for.
+//
+//	"sector" is the disk sector containing the file header
+//----------------------------------------------------------------------
+
+void
+FileHeader::Visited(int sector)
+{
+    time_t now = time(NULL);
+
+    if (timeUpdate == TimeNoVisit)
+	return;
+    if (timeUpdate == TimeRelaxed) {
+	if ((lastVisitTime > lastWriteTime) &&
+		(now - lastVisitTime < RelaxedVisitTime))
+	    return;			// still recent enough
+	if (lastVisitTime == now)
+	    return;			// nothing would change
+    }
+    lastVisitTime = now;
+    Changed(sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Written
+// 	Stamp the modify time, and unless visit times are off, the visit
+//	time, of a file that was just written.
+//
+//	"sector" is the disk sector containing the file header
+//----------------------------------------------------------------------
+
+void
+FileHeader::Written(int sector)
+{
+    time_t now = time(NULL);
+
+    if ((timeUpdate != TimeStrict) && (lastWriteTime == now) &&
+	    ((timeUpdate == TimeNoVisit) || (lastVisitTime == now)))
+	return;				// nothing would change
+    if (timeUpdate != TimeNoVisit)
+	lastVisitTime = now;
+    lastWriteTime = now;
+    Changed(sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Changed
+// 	Note that the header was changed in memory.  Under the strict
+//	policy it goes straight back to disk; otherwise it waits until
+//	the file is closed, or the file system is synced.
+//
+//	"sector" is the disk sector containing the file header
+//----------------------------------------------------------------------
+
+void
+FileHeader::Changed(int sector)
+{
+    dirty = TRUE;
+    if (timeUpdate == TimeStrict)
+	WriteBack(sector);
 }
 
 //----------------------------------------------------------------------
@@ -248,13 +352,78 @@ FileHeader::ByteToSector(int offset)
     int i = offset/(SectorSize*32);
     int i_offset = offset % (SectorSize*32);
     i_offset = i_offset / SectorSize;
-    int tempDataSectors[32];
     //printf("primTable[%d]:%d\n",i, primaryIndexTable[i]);
-    synchDisk->ReadSector(primaryIndexTable[i], (char*)tempDataSectors);
-    return(tempDataSectors[i_offset]);
+    LoadIndex();
+    return(indexCache[i][i_offset]);
     //return(dataSectors[offset / SectorSize]);
 }
 
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex
+// 	Read the file's index blocks into memory, unless they already are.
+//	Room is left for as many as the file could ever have, so that
+//	ExtendAllocate can add to them.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadIndex()
+{
+    int numPrimaryIndexTableEntries = divRoundUp(numSectors, IndexEntries);
+
+    if (indexCache != NULL)
+	return;
+    indexCache = new int[NumDirect][IndexEntries];
+    for (int i = 0; i < numPrimaryIndexTableEntries; i++)
+	synchDisk->ReadSector(primaryIndexTable[i], (char *) indexCache[i]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DropIndex
+// 	Forget the index blocks kept in memory, if there are any.
+//----------------------------------------------------------------------
+
+void
+FileHeader::DropIndex()
+{
+    delete [] indexCache;
+    indexCache = NULL;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadIndex
+// 	Get the contents of one of the file's index blocks; from memory,
+//	if they are there.
+//
+//	"i" -- which index block, counting from 0
+//	"into" -- where to put its IndexEntries sector numbers
+//----------------------------------------------------------------------
+
+void
+FileHeader::ReadIndex(int i, int *into)
+{
+    if (indexCache != NULL)
+	bcopy((char *) indexCache[i], (char *) into, SectorSize);
+    else
+	synchDisk->ReadSector(primaryIndexTable[i], (char *) into);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WriteIndex
+// 	Change one of the file's index blocks, on disk and, if they are
+//	there, in memory.
+//
+//	"i" -- which index block, counting from 0
+//	"from" -- its new IndexEntries sector numbers
+//----------------------------------------------------------------------
+
+void
+FileHeader::WriteIndex(int i, int *from)
+{
+    synchDisk->WriteSector(primaryIndexTable[i], (char *) from);
+    if (indexCache != NULL)
+	bcopy((char *) from, (char *) indexCache[i], SectorSize);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FileLength
 // 	Return the number of bytes in the file.
@@ -289,7 +458,7 @@ FileHeader::Print()
 
 
     for (i = k = 0; i < numPrimaryIndexTableEntries; i++) {
-        synchDisk->ReadSector(primaryIndexTable[i], (char*)tempDataSectors);
+        ReadIndex(i, tempDataSectors);
         //printf("tempDataSectors[0]:%d tempDataSectors[1]:%d\n", tempDataSectors[0], tempDataSectors[1]);
         if(tempNumSectors < 32)
         {
@@ -325,3 +494,96 @@ FileHeader::Print()
     delete [] data;
 
 }
+
+//----------------------------------------------------------------------
+// HeaderTable::HeaderTable
+// 	Initialize the table of file headers in use; none are, yet.
+//----------------------------------------------------------------------
+
+HeaderTable::HeaderTable()
+{
+    headers = new FileHeader *[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	headers[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::~HeaderTable
+// 	De-allocate the table, and the headers still in it.
+//----------------------------------------------------------------------
+
+HeaderTable::~HeaderTable()
+{
+    for (int i = 0; i < NumSectors; i++)
+	delete headers[i];
+    delete [] headers;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Open
+// 	Return the header stored in a sector, the same copy to everyone
+//	using the file.  Only the first user has to read it from disk.
+//	The sector's semaphore keeps anyone from using the header while
+//	it is being read, or written back by Close.
+//
+//	"sector" -- the disk sector holding the header
+//----------------------------------------------------------------------
+
+FileHeader *
+HeaderTable::Open(int sector)
+{
+    FileHeader *hdr;
+
+    synchDisk->rw_P(sector);
+    hdr = headers[sector];
+    if (hdr == NULL) {
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	headers[sector] = hdr;
+    }
+    hdr->refs++;
+    synchDisk->rw_V(sector);
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Close
+// 	Give up a header returned by Open.  The last one to do so writes
+//	it back, if it was changed, and de-allocates it.
+//
+//	"sector" -- the disk sector holding the header
+//----------------------------------------------------------------------
+
+void
+HeaderTable::Close(int sector)
+{
+    FileHeader *hdr = headers[sector];
+
+    ASSERT((hdr != NULL) && (hdr->refs > 0));
+    synchDisk->rw_P(sector);
+    if (--hdr->refs == 0) {
+	if (hdr->dirty)
+	    hdr->WriteBack(sector);
+	headers[sector] = NULL;
+	delete hdr;
+    }
+    synchDisk->rw_V(sector);
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Sync
+// 	Write every header that was changed back to disk, keeping it in
+//	memory.
+//----------------------------------------------------------------------
+
+void
+HeaderTable::Sync()
+{
+    for (int i = 0; i < NumSectors; i++)
+	if (headers[i] != NULL) {
+	    synchDisk->rw_P(i);		// it may be closed while we wait
+	    if ((headers[i] != NULL) && headers[i]->dirty)
+		headers[i]->WriteBack(i);
+	    synchDisk->rw_V(i);
+	}
+}
@@ -19,6 +19,8 @@
 #include <time.h>
 #define NumDirect 	((SectorSize - 7 * sizeof(int)) / sizeof(int))
 #define MaxFileSize 	(NumDirect * SectorSize)
+#define IndexEntries	(SectorSize / sizeof(int))	// data sectors
+							// in an index block
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -31,12 +33,40 @@
 // as one disk sector.  Without indirect addressing, this
 // limits the maximum file length to just under 4K bytes.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The file header is initialized by allocating blocks for the file (if
+// it is a new file), or by reading it from disk.
+//
+// Only the first SectorSize bytes -- everything but the index cache --
+// are stored on disk.  The index cache holds the file's index blocks
+// once ByteToSector has needed them, so that finding a sector of the
+// file is a memory lookup; it is kept up to date as blocks are
+// allocated, and thrown away if the header read back from disk shows
+// another copy of it has changed the file's blocks.
+//
+// While a file is open, its header stays in memory, in the header
+// table; everyone using the file shares the one copy, which is only
+// written back to disk if it was changed.
+//
+// How eagerly the visit and modify times are kept up to date is set
+// when the file system is started, like a UNIX mount option:
+//	TimeStrict -- every open, read or write stamps the header, and
+//		writes it straight back to disk
+//	TimeRelaxed -- the visit time is only stamped if the file was
+//		written since it was last visited, or that was a day ago;
+//		the header goes back to disk when it is closed or synced
+//	TimeNoVisit -- the visit time is never stamped; otherwise as
+//		TimeRelaxed
+
+enum TimeUpdate { TimeStrict, TimeRelaxed, TimeNoVisit };
+
+#define RelaxedVisitTime	(24 * 60 * 60)	// seconds a relaxed visit
+						// time may fall behind
 
 class FileHeader {
   public:
+    FileHeader();			// No index blocks in memory yet
+    ~FileHeader();
+
     bool Allocate(BitMap *bitMap, int fileSize, int fileType);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
@@ -58,6 +88,11 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
+    void Visited(int sector);		// The file was opened or read
+    void Written(int sector);		// The file was written
+    void Changed(int sector);		// The header, stored in "sector",
+					// was changed in memory
+
     time_t createTime; // time ticks when the file create
     time_t lastVisitTime; // last time ticks when visiting the file
     time_t lastWriteTime;//last time ticks when writing the file
@@ -71,8 +106,40 @@ class FileHeader {
     //int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
 
+    int (*indexCache)[IndexEntries];	// The index blocks, or NULL if
+					// they have not been read
     
-    
+    void LoadIndex();			// Read the index blocks into memory
+    void DropIndex();			// Forget them
+    void ReadIndex(int i, int *into);	// Get index block "i"
+    void WriteIndex(int i, int *from);	// Change index block "i"
+
+  public:
+    int refs;				// Users of this copy, while it is
+					// in the header table
+    bool dirty;				// Changed since it was on disk?
+};
+
+// The following class keeps the headers of the files in use in memory,
+// one per header sector, however many times the file is open; it plays
+// the part of the UNIX in-core inode table.
+
+class HeaderTable {
+  public:
+    HeaderTable();			// No headers in memory yet
+    ~HeaderTable();
+
+    FileHeader *Open(int sector);	// Get the header in "sector",
+					// reading it from disk if no one
+					// is using it
+    void Close(int sector);		// Done with it; when everyone is,
+					// write it back if it was changed,
+					// and let it go
+    void Sync();			// Write back every changed header
+
+  private:
+    FileHeader **headers;		// For each sector, the header in
+					// use there, or NULL
 };
 
 #endif // FILEHDR_H
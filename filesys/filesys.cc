@@ -50,6 +50,7 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -72,7 +73,9 @@
 //	not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory, and read in the bitmap.
+//	It stays in memory from then on, and is only written back to
+//	disk, if it was changed, when the file system is synced.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -82,9 +85,10 @@ FileSystem::FileSystem(bool format)
     //printf("initialize\n");
     //mutex = new Semaphore("mutex", 1);
     DEBUG('f', "Initializing the file system.\n");
+    freeMapChanged = FALSE;
     if (format) {
 
-        BitMap *freeMap = new BitMap(NumSectors);
+        freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	    FileHeader *mapHdr = new FileHeader;
 	    FileHeader *dirHdr = new FileHeader;
@@ -134,7 +138,6 @@ FileSystem::FileSystem(bool format)
     	    freeMap->Print();
     	    directory->Print();
 
-            delete freeMap; 
         	delete directory; 
         	delete mapHdr; 
         	delete dirHdr;
@@ -144,9 +147,23 @@ FileSystem::FileSystem(bool format)
     // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = new BitMap(NumSectors);
+        freeMap->FetchFrom(freeMapFile);
     }
 }
 
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	De-allocate the bitmap of free blocks kept in memory.  Cleanup
+//	has synced the file system before it gets here, on every way out
+//	of Nachos, so the bitmap is already on disk.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    delete freeMap;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
@@ -183,7 +200,6 @@ FileSystem::Create(char *Name, int initialSize, int fileType)
     char * name = new char[strlen(Name)];
     strcpy(name, Name);
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
     OpenFile *currDirectoryFile;
    // FileHeader *dirHdr = new FileHeader;
@@ -210,19 +226,21 @@ FileSystem::Create(char *Name, int initialSize, int fileType)
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         //freeMap->Print();
         sector = freeMap->Find();	// find a sector to hold the file header
         if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
+        else if (!directory->Add(name, sector)) {
+            freeMap->Clear(sector);
             success = FALSE;	// no space in directory
+        }
 	    else {
     	    hdr = new FileHeader;
             //printf("try to allocate\n");
-	        if (!hdr->Allocate(freeMap, initialSize, fileType))
+	        if (!hdr->Allocate(freeMap, initialSize, fileType)) {
+                freeMap->Clear(sector);
             	success = FALSE;	// no space on disk for data
+            }
 	        else {
            // printf("everything worked\n");	
 	    	    success = TRUE;
@@ -255,12 +273,11 @@ FileSystem::Create(char *Name, int initialSize, int fileType)
     	    	directory->WriteBack(currDirectoryFile);
                 directory->FetchFrom(currDirectoryFile);
                 directory->List();
-    	    	freeMap->WriteBack(freeMapFile);
+    	    	freeMapChanged = TRUE;
                // directory->Print();
 	        }
             delete hdr;
 	    }
-        delete freeMap;
         //delete mapHdr;
     }
     delete currDirectoryFile;
@@ -301,11 +318,9 @@ FileSystem::Open(char *Name)
     if (sector >= 0) 
     {
         //mutex->P();
-        FileHeader *fileHdr = new FileHeader;
-        fileHdr->FetchFrom(sector);
-        fileHdr->numVisits ++;
-        fileHdr->WriteBack(sector);
     	openFile = new OpenFile(sector);	// name was found in directory 
+        openFile->hdr->numVisits ++;
+        openFile->hdr->Changed(sector);
         //mutex->V();
     }
     delete directory;
@@ -332,7 +347,6 @@ FileSystem::Remove(char *Name)
     char *name = new char[strlen(Name)];
     strcpy(name, Name);
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
     OpenFile *openFile;
     int sector;
@@ -357,8 +371,7 @@ FileSystem::Remove(char *Name)
     }
     */
     //mutex->P();
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    fileHdr = headerTable->Open(sector);
     //is file
     if(fileHdr->fileType == 0)
     {
@@ -367,7 +380,8 @@ FileSystem::Remove(char *Name)
         if(fileHdr->numVisits != 1)
         {
             fileHdr->numVisits --;
-            fileHdr->WriteBack(sector);
+            fileHdr->Changed(sector);
+            headerTable->Close(sector);
             printf("remove failed\n");
             
             return FALSE;
@@ -376,18 +390,16 @@ FileSystem::Remove(char *Name)
         else
         {
             fileHdr->numVisits --;
-            fileHdr->WriteBack(sector);
             
-        
-            freeMap = new BitMap(NumSectors);
-            freeMap->FetchFrom(freeMapFile);
 
             fileHdr->Deallocate(freeMap);  		// remove data blocks
+            fileHdr->dirty = FALSE;		// the header is gone, and
+            headerTable->Close(sector);		// its sector may be reused
             freeMap->Clear(sector);			// remove header block
 
             directory->Remove(name);
            // printf("2\n");
-            freeMap->WriteBack(freeMapFile);		// flush to disk
+            freeMapChanged = TRUE;
 
             directory->WriteBack(openFile);        // flush to disk
            printf("remove success!\n");
@@ -414,17 +426,17 @@ FileSystem::Remove(char *Name)
             }
            
         }
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
+        delete dirFile;
 
         fileHdr->Deallocate(freeMap);       // remove data blocks
+        fileHdr->dirty = FALSE;
+        headerTable->Close(sector);
         freeMap->Clear(sector);         // remove header block
 
         directory->Remove(name);
-        freeMap->WriteBack(freeMapFile);        // flush to disk
+        freeMapChanged = TRUE;
 
         directory->WriteBack(openFile);        // flush to disk
-        delete dirFile;
         delete dir;
         /*debug
         printf("direcotry content:\n");
@@ -439,9 +451,7 @@ FileSystem::Remove(char *Name)
     freeMap->Print();
     if(openFile != NULL)
         delete openFile;
-    delete fileHdr;
     delete directory;
-    delete freeMap;
     return TRUE;
 } 
 
@@ -473,33 +483,71 @@ FileSystem::List()
 void
 FileSystem::Print()
 {
-    FileHeader *bitHdr = new FileHeader;
-    FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
+    FileHeader *bitHdr = headerTable->Open(FreeMapSector);
+    FileHeader *dirHdr = headerTable->Open(DirectorySector);
     Directory *directory = new Directory(NumDirEntries);
 
+    if (freeMapChanged) {		// so the bitmap file's contents,
+	freeMap->WriteBack(freeMapFile);	// printed below, are current
+	freeMapChanged = FALSE;
+    }
+
     printf("Bit map file header:\n");
     printf("-----------------------------------------\n");
-    bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
     printf("-----------------------------------------\n");
     printf("Directory file header:\n");
     printf("-----------------------------------------\n");
-    dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
     printf("-----------------------------------------\n");
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
     printf("-----------------------------------------\n");
     directory->FetchFrom(directoryFile);
     directory->Print();
     printf("-----------------------------------------\n");
-    delete bitHdr;
-    delete dirHdr;
-    delete freeMap;
+    headerTable->Close(FreeMapSector);
+    headerTable->Close(DirectorySector);
     delete directory;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write the bitmap of free blocks, if it was changed, and the file
+//	headers that were changed in memory, and then the disk's changed
+//	buffers, back to the disk.  Cleanup calls this before Nachos
+//	quits; until then, a changed bitmap stays only in memory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    if (freeMapChanged) {
+	freeMap->WriteBack(freeMapFile);
+	freeMapChanged = FALSE;
+    }
+    headerTable->Sync();
+    synchDisk->Sync();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Extend
+// 	Allocate data blocks for "extraFileSize" more bytes of a file,
+//	from the bitmap of free blocks kept in memory.  Return FALSE if
+//	there is not enough room on the disk.
+//
+//	"hdr" -- the header of the file to grow
+//	"extraFileSize" -- how many bytes to add to the file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Extend(FileHeader *hdr, int extraFileSize)
+{
+    if (!hdr->ExtendAllocate(freeMap, extraFileSize))
+	return FALSE;
+    freeMapChanged = TRUE;
+    return TRUE;
+}
+
 
 
 void
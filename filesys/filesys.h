@@ -66,6 +66,9 @@ class FileSystem {
 };
 
 #else // FILESYS
+class FileHeader;
+class BitMap;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -74,6 +77,8 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// De-allocate the bitmap kept in
+					// memory
 
     bool Create(char *name, int initialSize, int _fileType);  	
 					// Create a file (UNIX creat)
@@ -86,11 +91,20 @@ class FileSystem {
 
     void Print();			// List all the files and their contents
 
+    void Sync();			// Write everything changed in memory
+					// back to the disk
+
+    bool Extend(FileHeader *hdr, int extraFileSize);
+					// Give a file more data blocks
+
     void getFileName(char *&name, Directory *&directory, OpenFile *& Cur);
    // Semaphore *mutex;
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   BitMap *freeMap;			// The bit map itself, kept in memory
+					// while Nachos is running
+   bool freeMapChanged;			// Does the file need writing back?
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
 
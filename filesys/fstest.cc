@@ -174,6 +174,8 @@ FileRead()
 void
 PerformanceTest()
 {
+    int writes = stats->numDiskWrites;
+
     printf("Starting file system performance test:\n");
    // stats->Print();
     printf("-----------------------------------------\n");
@@ -190,6 +192,9 @@ PerformanceTest()
     fileSystem->Remove(FileName);
     fileSystem->Remove(FileName);
    
+    fileSystem->Sync();		// count the writes that were put off
+    printf("Disk writes: %d before the test, %d after\n", writes,
+	stats->numDiskWrites);
 
     //stats->Print();
 }
@@ -22,23 +22,20 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open; it is shared with everyone
+//	else who has the file open, through the header table.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    synchDisk->rw_P(sector);
-    hdr->FetchFrom(sector);
+    hdr = headerTable->Open(sector);
     hdrSectorNumber = sector;
     //printf("open sector:%d\n", sector);
     //printf("lastVisitTime addr:%x\n", &(hdr->lastVisitTime));
     //hdr->numVisits += 1;
-    time(&(hdr->lastVisitTime));
-    hdr->WriteBack(sector);
-    synchDisk->rw_V(sector);
+    hdr->Visited(sector);
     //printf("lastVisitTime:%s\n", ctime(&(hdr->lastVisitTime)));
     seekPosition = 0;
 }
@@ -46,11 +43,13 @@ OpenFile::OpenFile(int sector)
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The header is written back, if it was changed, once no one else
+//	has the file open.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    headerTable->Close(hdrSectorNumber);
 }
 
 //----------------------------------------------------------------------
@@ -126,11 +125,8 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
 
-    synchDisk->rw_P(hdrSectorNumber);
-    hdr->FetchFrom(hdrSectorNumber);
-    synchDisk->rw_V(hdrSectorNumber);
     //modify time
-    time(&(hdr->lastVisitTime));
+    hdr->Visited(hdrSectorNumber);
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
     char *buf;
@@ -176,13 +172,8 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
 
-    synchDisk->rw_P(hdrSectorNumber);
-    hdr->FetchFrom(hdrSectorNumber);
-    synchDisk->rw_V(hdrSectorNumber);
-
     //modify time
-    time(&(hdr->lastVisitTime));
-    time(&(hdr->lastWriteTime));
+    hdr->Written(hdrSectorNumber);
     //printf("lastVisitTime:%d  lastWriteTime:%d hdr->b2s:%d\n", hdr->lastVisitTime, hdr->lastWriteTime, hdr->ByteToSector(0));
 
     int fileLength = hdr->FileLength();
@@ -195,21 +186,13 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     if ((position + numBytes) > fileLength)
     {
         int extraFileLength = numBytes + position - fileLength;
-        int extraSectors = divRoundUp(extraFileLength, SectorSize);
-        BitMap *freeMap = new BitMap(NumSectors);
-        OpenFile *freeMapFile = new OpenFile(0);
-        freeMap->FetchFrom(freeMapFile);
-        if(!hdr->ExtendAllocate(freeMap, extraFileLength))
+        if(!fileSystem->Extend(hdr, extraFileLength))
         {
             printf("extend allocate failed\n");
             return 0;
         }
-        //need to write back header
+        hdr->Changed(hdrSectorNumber);
        // printf("hdr sector number:%d\n", hdrSectorNumber);
-
-        hdr->WriteBack(hdrSectorNumber);
-        delete freeMap;
-        delete freeMapFile;
     }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
@@ -52,6 +52,11 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+
+    int HeaderSector() { return FileNumber(file); }
+					// Identify the file; the UNIX file
+					// number stands in for the sector
+					// holding a Nachos file header
     
   private:
     int file;
@@ -85,6 +90,8 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int HeaderSector() { return hdrSectorNumber; }
+					// Identify the file
     FileHeader *hdr;
     int hdrSectorNumber;
   private:
@@ -10,12 +10,23 @@
 //	handle one operation at a time, use a lock to enforce mutual
 //	exclusion.
 //
+//	With a buffer cache, the lock also protects the buffers.  Reads
+//	are served from a buffer when the sector has one; otherwise the
+//	least recently used buffer is taken, written back first if it was
+//	changed, and the sector is read into it.  Writes go to a buffer
+//	only, and reach the disk later.  The buffers are kept on a list
+//	in the order they were used, so that finding the least recently
+//	used one takes no search.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
+
+#include <strings.h>
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -38,9 +49,10 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"cacheSize" -- how many sectors to keep in memory; 0 for none
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int cacheSize)
 {
     semaphore = new Semaphore("synch disk", 0);
     for(int i = 0; i < 1024; i ++)
@@ -50,6 +62,24 @@ SynchDisk::SynchDisk(char* name)
     lock = new Lock("synch disk lock");
     disk = new Disk(name, DiskRequestDone, (int) this);
     array_mutex = new Semaphore("array mutex", 1);
+
+    numBuffers = cacheSize;
+    buffers = new SectorBuffer[numBuffers];
+    leastRecent = mostRecent = NULL;
+    for (int i = 0; i < numBuffers; i++) {
+	buffers[i].sector = -1;
+	buffers[i].dirty = FALSE;
+	buffers[i].prev = mostRecent;
+	buffers[i].next = NULL;
+	if (mostRecent == NULL)
+	    leastRecent = &buffers[i];
+	else
+	    mostRecent->next = &buffers[i];
+	mostRecent = &buffers[i];
+    }
+    bufferOf = new int[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	bufferOf[i] = -1;
 }
 
 //----------------------------------------------------------------------
@@ -60,6 +90,8 @@ SynchDisk::SynchDisk(char* name)
 
 SynchDisk::~SynchDisk()
 {
+    delete [] buffers;
+    delete [] bufferOf;
     delete disk;
     delete lock;
     delete semaphore;
@@ -81,8 +113,10 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 {
    //printf("sectorNumber:%d\n",sectorNumber);
     lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    if (numBuffers == 0)
+	Transfer(sectorNumber, data, FALSE);
+    else
+	bcopy(FindBuffer(sectorNumber, TRUE)->data, data, SectorSize);
     lock->Release();
 }
 
@@ -91,6 +125,8 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 // 	Write the contents of a buffer into a disk sector.  Return only
 //	after the data has been written.
 //
+//	With a buffer cache, return as soon as the buffer has it.
+//
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
 //----------------------------------------------------------------------
@@ -98,12 +134,125 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
+    SectorBuffer *buffer;
+
     lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    if (numBuffers == 0)
+	Transfer(sectorNumber, data, TRUE);
+    else {
+	buffer = FindBuffer(sectorNumber, FALSE);
+	bcopy(data, buffer->data, SectorSize);
+	buffer->dirty = TRUE;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every buffer that was changed back to the disk, so that the
+//	disk is up to date.  Return only after the data has been written.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    lock->Acquire();
+    for (int i = 0; i < numBuffers; i++)
+	if (buffers[i].dirty) {
+	    Transfer(buffers[i].sector, buffers[i].data, TRUE);
+	    buffers[i].dirty = FALSE;
+	    stats->numBufferWriteBacks++;
+	}
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchDisk::FindBuffer
+// 	Return the buffer holding a sector, marked as just used.  If no
+//	buffer has it, take the one least recently used (empty buffers
+//	stay at the front of the list until they are taken), writing what
+//	it holds back first if that was changed.  The caller holds the
+//	lock.
+//
+//	"sectorNumber" -- the sector wanted
+//	"fill" -- read the sector into the buffer, if it has to be taken?
+//		Not needed if the whole sector is about to be written.
+//----------------------------------------------------------------------
+
+SectorBuffer *
+SynchDisk::FindBuffer(int sectorNumber, bool fill)
+{
+    SectorBuffer *buffer;
+
+    if (bufferOf[sectorNumber] >= 0) {
+	buffer = &buffers[bufferOf[sectorNumber]];
+	if (fill)
+	    stats->numBufferHits++;
+    } else {
+	buffer = leastRecent;
+	if (buffer->sector >= 0) {
+	    if (buffer->dirty) {
+		Transfer(buffer->sector, buffer->data, TRUE);
+		stats->numBufferWriteBacks++;
+	    }
+	    bufferOf[buffer->sector] = -1;
+	}
+	buffer->sector = sectorNumber;
+	buffer->dirty = FALSE;
+	bufferOf[sectorNumber] = buffer - buffers;
+	if (fill) {
+	    Transfer(sectorNumber, buffer->data, FALSE);
+	    stats->numBufferMisses++;
+	}
+    }
+    MoveToEnd(buffer);
+    return buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MoveToEnd
+// 	Move a buffer to the most recently used end of the LRU list.  The
+//	caller holds the lock.
+//
+//	"buffer" -- the buffer just read or written
+//----------------------------------------------------------------------
+
+void
+SynchDisk::MoveToEnd(SectorBuffer *buffer)
+{
+    if (buffer == mostRecent)
+	return;
+    if (buffer->prev == NULL)
+	leastRecent = buffer->next;
+    else
+	buffer->prev->next = buffer->next;
+    buffer->next->prev = buffer->prev;
+    buffer->prev = mostRecent;
+    buffer->next = NULL;
+    mostRecent->next = buffer;
+    mostRecent = buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Send one request to the disk, and wait for it to finish.  The
+//	caller holds the lock.
+//
+//	"sectorNumber" -- the disk sector to read or write
+//	"data" -- where the contents go, or come from
+//	"writing" -- write the sector, rather than read it?
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sectorNumber, char* data, bool writing)
+{
+    if (writing)
+	disk->WriteRequest(sectorNumber, data);
+    else
+	disk->ReadRequest(sectorNumber, data);
+    semaphore->P();			// wait for interrupt
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
 // 	Disk interrupt handler.  Wake up any thread waiting for the disk
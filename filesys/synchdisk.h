@@ -2,6 +2,11 @@
 // 	Data structures to export a synchronous interface to the raw 
 //	disk device.
 //
+//	Optionally, recently used sectors are kept in a buffer cache, so
+//	that reading one again costs no disk I/O.  Writes only change the
+//	buffer; a changed sector goes to the disk when its buffer is
+//	reused, or when the disk is synced.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -14,6 +19,18 @@
 #include "disk.h"
 #include "synch.h"
 
+// A copy of one disk sector kept in memory.
+
+class SectorBuffer {
+  public:
+    int sector;				// the sector it holds, or -1
+    bool dirty;				// changed since it was on disk?
+    SectorBuffer *prev;			// neighbours in the LRU list, which
+    SectorBuffer *next;			// runs from least to most recently
+    					// used
+    char data[SectorSize];		// the sector's contents
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -26,8 +43,10 @@
 // returning.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(char* name, int cacheSize);
+    					// Initialize a synchronous disk,
+					// by initializing the raw Disk,
+					// with "cacheSize" sector buffers
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -37,6 +56,8 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void Sync();			// Write every changed buffer back
+    					// to the disk
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
@@ -53,6 +74,21 @@ class SynchDisk {
 					// can be sent to the disk at a time
     Semaphore *mutex[1024];
     Semaphore *array_mutex;
+
+    SectorBuffer *buffers;		// The buffer cache
+    int numBuffers;			// How many buffers it has
+    int *bufferOf;			// For each sector, the buffer that
+    					// holds it, or -1
+    SectorBuffer *leastRecent;		// Ends of the LRU list
+    SectorBuffer *mostRecent;
+
+    SectorBuffer *FindBuffer(int sectorNumber, bool fill);
+    					// Get the buffer for a sector,
+    					// replacing the least recently used
+    void MoveToEnd(SectorBuffer *buffer);
+    					// Mark a buffer as just used
+    void Transfer(int sectorNumber, char* data, bool writing);
+    					// Do one disk request and wait
 };
 
 #endif // SYNCHDISK_H
@@ -0,0 +1,505 @@
+// blocksim.cc -- threaded-code engine for the MIPS simulator
+//
+//   Instead of decoding each instruction and dispatching through the
+//   switch in mipssim.cc, we translate a basic block at a time into an
+//   array of (handler address, decoded instruction) pairs, and jump
+//   straight from one handler to the next using gcc's computed goto.
+//
+//   Blocks are cached by physical address, alongside the predecoded
+//   instructions, and are thrown away by InvalidateDecodedPage when the
+//   page they live in is written or replaced.
+//
+//   Every handler has exactly the same effect on the registers and memory
+//   as the matching case in Machine::ExecuteInstruction.  The less common
+//   instructions (multiply, divide, unaligned loads and stores,
+//   syscalls...) are simply passed to ExecuteInstruction.
+//
+//   Simulated time is charged a block at a time rather than calling
+//   OneTick after every instruction.  Before running a block we ask the
+//   interrupt simulation how long it is until the next pending interrupt
+//   is due; only the instruction that reaches that time, or one that
+//   traps into the kernel, goes through OneTick.  Interrupts therefore
+//   fire at exactly the same simulated time as they would under Run.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// IsBranch, IsTrap
+// 	Does this instruction end a basic block?  Branches and jumps end
+//	a block after their delay slot; traps end it right away.
+//----------------------------------------------------------------------
+
+static bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+static bool
+IsTrap(int opCode)
+{
+    return (opCode == OP_SYSCALL) || (opCode == OP_RES)
+		|| (opCode == OP_UNIMP);
+}
+
+//----------------------------------------------------------------------
+// Machine::RunThreaded
+// 	Simulate the execution of a user program one basic block at a
+//	time.  Called by Run; never returns.
+//
+//	Like Run, the loop keeps no state of its own between blocks --
+//	everything lives in the registers and memory -- so it can be
+//	switched out in the middle of a block and resumed later.
+//----------------------------------------------------------------------
+
+void
+Machine::RunThreaded()
+{
+    TranslatedBlock *block;
+    int physAddr;
+
+    if (threadedHandlers == NULL)
+	ExecuteBlock(NULL);		// fill in the handler table
+    for (;;) {
+	if (!TranslatePC(&physAddr)) {	// the fetch trapped to the kernel
+	    interrupt->OneTick();
+	    continue;
+	}
+	block = blockAt[physAddr / 4];
+	if (block == NULL)
+	    block = TranslateBlock(physAddr);
+	ExecuteBlock(block);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Translate the basic block starting at a physical address, and
+//	remember it for next time.
+//
+//	"physAddr" -- word-aligned physical address of the first instruction
+//----------------------------------------------------------------------
+
+TranslatedBlock *
+Machine::TranslateBlock(int physAddr)
+{
+    TranslatedBlock *block = new TranslatedBlock;
+    int pageEnd = (physAddr / PageSize + 1) * PageSize;
+    int addr = physAddr;
+    ThreadedInstr *t;
+
+    block->frame = physAddr / PageSize;
+    block->length = 0;
+    while ((addr < pageEnd) && (block->length < MaxBlockLength)) {
+	t = &block->code[block->length++];
+	t->instr = *DecodedAt(addr);
+	t->handler = threadedHandlers[t->instr.opCode];
+	addr += 4;
+	if (IsTrap(t->instr.opCode))
+	    break;
+	if (IsBranch(t->instr.opCode)) {
+	    if ((addr < pageEnd) && (block->length < MaxBlockLength)) {
+		t = &block->code[block->length++];	// the delay slot
+		t->instr = *DecodedAt(addr);
+		t->handler = threadedHandlers[t->instr.opCode];
+	    }
+	    break;
+	}
+    }
+    blockAt[physAddr / 4] = block;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteBlock
+// 	Run the instructions of a translated block, starting at the
+//	current PC.  Instructions that cannot make an interrupt due are
+//	counted in "pendingTicks" and charged together when we leave the
+//	block (or earlier, by RaiseException, if the kernel is entered);
+//	the rest are followed by a call to OneTick, as in Run.
+//
+//	We leave the block as soon as the PC is not the next instruction
+//	in the block -- because a branch was taken, or an instruction
+//	trapped and left the PC alone -- or when a context switch during
+//	the tick threw blocks away.
+//
+//	Called once with a NULL block, to fill in "threadedHandlers"; the
+//	handler labels are only visible inside this routine.
+//
+//	"block" -- the block whose first instruction is at the current PC
+//----------------------------------------------------------------------
+
+void
+Machine::ExecuteBlock(TranslatedBlock *block)
+{
+    static void *handlers[MaxOpcode + 1];
+    ThreadedInstr *ip, *end;
+    Instruction *instr;
+    int pc, generation, budget, pcAfter, nextLoadReg, nextLoadValue;
+    int sum, tmp, value;
+    unsigned int rs, rt, imm;
+
+    if (block == NULL) {
+	for (int i = 0; i <= MaxOpcode; i++)
+	    handlers[i] = &&generic;
+	handlers[OP_ADD] = &&op_add;
+	handlers[OP_ADDI] = &&op_addi;
+	handlers[OP_ADDIU] = &&op_addiu;
+	handlers[OP_ADDU] = &&op_addu;
+	handlers[OP_AND] = &&op_and;
+	handlers[OP_ANDI] = &&op_andi;
+	handlers[OP_BEQ] = &&op_beq;
+	handlers[OP_BGEZ] = &&op_bgez;
+	handlers[OP_BGEZAL] = &&op_bgezal;
+	handlers[OP_BGTZ] = &&op_bgtz;
+	handlers[OP_BLEZ] = &&op_blez;
+	handlers[OP_BLTZ] = &&op_bltz;
+	handlers[OP_BLTZAL] = &&op_bltzal;
+	handlers[OP_BNE] = &&op_bne;
+	handlers[OP_J] = &&op_j;
+	handlers[OP_JAL] = &&op_jal;
+	handlers[OP_JALR] = &&op_jalr;
+	handlers[OP_JR] = &&op_jr;
+	handlers[OP_LB] = &&op_lb;
+	handlers[OP_LBU] = &&op_lb;
+	handlers[OP_LH] = &&op_lh;
+	handlers[OP_LHU] = &&op_lh;
+	handlers[OP_LUI] = &&op_lui;
+	handlers[OP_LW] = &&op_lw;
+	handlers[OP_MFHI] = &&op_mfhi;
+	handlers[OP_MFLO] = &&op_mflo;
+	handlers[OP_MTHI] = &&op_mthi;
+	handlers[OP_MTLO] = &&op_mtlo;
+	handlers[OP_NOR] = &&op_nor;
+	handlers[OP_OR] = &&op_or;
+	handlers[OP_ORI] = &&op_ori;
+	handlers[OP_SB] = &&op_sb;
+	handlers[OP_SH] = &&op_sh;
+	handlers[OP_SLL] = &&op_sll;
+	handlers[OP_SLLV] = &&op_sllv;
+	handlers[OP_SLT] = &&op_slt;
+	handlers[OP_SLTI] = &&op_slti;
+	handlers[OP_SLTIU] = &&op_sltiu;
+	handlers[OP_SLTU] = &&op_sltu;
+	handlers[OP_SRA] = &&op_sra;
+	handlers[OP_SRAV] = &&op_srav;
+	handlers[OP_SRL] = &&op_srl;
+	handlers[OP_SRLV] = &&op_srlv;
+	handlers[OP_SUBU] = &&op_subu;
+	handlers[OP_SW] = &&op_sw;
+	handlers[OP_XOR] = &&op_xor;
+	handlers[OP_XORI] = &&op_xori;
+	threadedHandlers = handlers;
+	return;
+    }
+
+    ip = block->code;
+    end = ip + block->length;
+    pc = registers[PCReg];
+    generation = blockGeneration;
+    budget = interrupt->TicksUntilDue();
+
+  dispatch:
+    instr = &ip->instr;
+    pcAfter = registers[NextPCReg] + 4;
+    nextLoadReg = 0;
+    nextLoadValue = 0;
+    goto *ip->handler;
+
+  op_add:
+    sum = registers[instr->rs] + registers[instr->rt];
+    if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	goto ticked;
+    }
+    registers[instr->rd] = sum;
+    goto retire;
+
+  op_addi:
+    sum = registers[instr->rs] + instr->extra;
+    if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	goto ticked;
+    }
+    registers[instr->rt] = sum;
+    goto retire;
+
+  op_addiu:
+    registers[instr->rt] = registers[instr->rs] + instr->extra;
+    goto retire;
+
+  op_addu:
+    registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+    goto retire;
+
+  op_and:
+    registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+    goto retire;
+
+  op_andi:
+    registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
+    goto retire;
+
+  op_beq:
+    if (registers[instr->rs] == registers[instr->rt])
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_bgezal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_bgez:
+    if (!(registers[instr->rs] & SIGN_BIT))
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_bgtz:
+    if (registers[instr->rs] > 0)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_blez:
+    if (registers[instr->rs] <= 0)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_bltzal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_bltz:
+    if (registers[instr->rs] & SIGN_BIT)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_bne:
+    if (registers[instr->rs] != registers[instr->rt])
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    goto retire;
+
+  op_jal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_j:
+    pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    goto retire;
+
+  op_jalr:
+    registers[instr->rd] = registers[NextPCReg] + 4;
+  op_jr:
+    pcAfter = registers[instr->rs];
+    goto retire;
+
+  op_lb:
+    tmp = registers[instr->rs] + instr->extra;
+    if (!ReadMem(tmp, 1, &value))
+	goto ticked;
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto retire;
+
+  op_lh:
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x1) {
+	RaiseException(AddressErrorException, tmp);
+	goto ticked;
+    }
+    if (!ReadMem(tmp, 2, &value))
+	goto ticked;
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto retire;
+
+  op_lui:
+    registers[instr->rt] = instr->extra << 16;
+    goto retire;
+
+  op_lw:
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x3) {
+	RaiseException(AddressErrorException, tmp);
+	goto ticked;
+    }
+    if (!ReadMem(tmp, 4, &value))
+	goto ticked;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto retire;
+
+  op_mfhi:
+    registers[instr->rd] = registers[HiReg];
+    goto retire;
+
+  op_mflo:
+    registers[instr->rd] = registers[LoReg];
+    goto retire;
+
+  op_mthi:
+    registers[HiReg] = registers[instr->rs];
+    goto retire;
+
+  op_mtlo:
+    registers[LoReg] = registers[instr->rs];
+    goto retire;
+
+  op_nor:
+    registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
+    goto retire;
+
+  op_or:
+    registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
+    goto retire;
+
+  op_ori:
+    registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
+    goto retire;
+
+  // A store may hit the page this block lives in and free the block,
+  // so the store handlers must not look at "instr" after WriteMem.
+  op_sb:
+    if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra), 1,
+		registers[instr->rt]))
+	goto ticked;
+    goto retire;
+
+  op_sh:
+    if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra), 2,
+		registers[instr->rt]))
+	goto ticked;
+    goto retire;
+
+  op_sw:
+    if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra), 4,
+		registers[instr->rt]))
+	goto ticked;
+    goto retire;
+
+  op_sll:
+    registers[instr->rd] = registers[instr->rt] << instr->extra;
+    goto retire;
+
+  op_sllv:
+    registers[instr->rd] = registers[instr->rt] <<
+	(registers[instr->rs] & 0x1f);
+    goto retire;
+
+  op_slt:
+    registers[instr->rd] = (registers[instr->rs] < registers[instr->rt]);
+    goto retire;
+
+  op_slti:
+    registers[instr->rt] = (registers[instr->rs] < instr->extra);
+    goto retire;
+
+  op_sltiu:
+    rs = registers[instr->rs];
+    imm = instr->extra;
+    registers[instr->rt] = (rs < imm);
+    goto retire;
+
+  op_sltu:
+    rs = registers[instr->rs];
+    rt = registers[instr->rt];
+    registers[instr->rd] = (rs < rt);
+    goto retire;
+
+  op_sra:
+    registers[instr->rd] = registers[instr->rt] >> instr->extra;
+    goto retire;
+
+  op_srav:
+    registers[instr->rd] = registers[instr->rt] >>
+	(registers[instr->rs] & 0x1f);
+    goto retire;
+
+  op_srl:
+    tmp = registers[instr->rt];
+    tmp >>= instr->extra;
+    registers[instr->rd] = tmp;
+    goto retire;
+
+  op_srlv:
+    tmp = registers[instr->rt];
+    tmp >>= (registers[instr->rs] & 0x1f);
+    registers[instr->rd] = tmp;
+    goto retire;
+
+  op_subu:
+    registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
+    goto retire;
+
+  op_xor:
+    registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+    goto retire;
+
+  op_xori:
+    registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
+    goto retire;
+
+  generic:
+    ExecuteInstruction(instr);	// retires the instruction itself
+    goto ticked;
+
+  retire:
+    registers[registers[LoadReg]] = registers[LoadValueReg];
+    registers[LoadReg] = nextLoadReg;
+    registers[LoadValueReg] = nextLoadValue;
+    registers[0] = 0;
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = pcAfter;
+    if (--budget > 0) {			// no interrupt can be due yet
+	pendingTicks++;
+	ip++;
+	pc += 4;
+	if ((ip < end) && (registers[PCReg] == pc)
+			&& (generation == blockGeneration))
+	    goto fetch;
+	interrupt->AdvanceUserTicks(pendingTicks);
+	pendingTicks = 0;
+	return;
+    }
+
+  ticked:
+    if (pendingTicks > 0) {
+	interrupt->AdvanceUserTicks(pendingTicks);
+	pendingTicks = 0;
+    }
+    interrupt->OneTick();
+    if (generation != blockGeneration)
+	return;				// our block may be gone
+    budget = interrupt->TicksUntilDue();
+    ip++;
+    pc += 4;
+    if ((ip < end) && (registers[PCReg] == pc))
+	goto fetch;
+    return;
+
+  // account for the fetch of the next instruction, as Translate would
+  fetch:
+    pagehit++;
+    if (stampReferences)
+	pageLasttime[block->frame] = stats->totalTicks + pendingTicks;
+    goto dispatch;
+}
@@ -63,6 +63,8 @@ Interrupt::Interrupt()
     pending = new List();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
+    abortOnReturn = FALSE;
+    aborter = NULL;
     status = SystemMode;
 }
 
@@ -138,6 +140,18 @@ Interrupt::Enable()
     (void) SetLevel(IntOn); 
 }
 
+//----------------------------------------------------------------------
+// AbortThread
+// 	Clean up and quit, for a user who hit ctl-C.  Running as a thread
+//	of its own, holding nothing, Cleanup can wait for the disk.
+//----------------------------------------------------------------------
+
+static void
+AbortThread(int dummy)
+{
+    Cleanup();
+}
+
 //----------------------------------------------------------------------
 // Interrupt::OneTick
 // 	Advance simulated time and check if there are any pending 
@@ -179,6 +193,62 @@ Interrupt::OneTick()
 	status = old;
 	
     }
+    if (abortOnReturn)			// the user hit ctl-C
+	StartAbort();
+    if ((aborter != NULL) && (currentThread != aborter)
+	&& (aborter->getstatus() == READY)) {
+	// Let the cleanup finish, even if this thread would never give
+	// up the CPU.  Only worth it when the cleanup can run -- not
+	// while it waits on the disk, say.  Interrupts stay off across
+	// the Yield, so coming back does not tick (and yield) again
+	// inside this one.
+	ChangeLevel(IntOn, IntOff);
+	status = SystemMode;
+	currentThread->Yield();
+	status = old;
+	ChangeLevel(IntOff, IntOn);
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how many more user instructions can be run before the
+//	earliest pending interrupt is due.  The last of them is the one
+//	whose OneTick fires the interrupt; the ones before it can be
+//	charged in a batch with AdvanceUserTicks instead.
+//
+//	Only meaningful in user mode -- kernel code moves the clock by
+//	SystemTick, and may schedule new interrupts.
+//----------------------------------------------------------------------
+
+int
+Interrupt::TicksUntilDue()
+{
+    ListElement *next = pending->FirstItem();
+
+    if (abortOnReturn || (aborter != NULL))
+	return 0;			// get to OneTick as soon as we can
+    if (next == NULL)
+	return 0x7fffffff;		// nothing will ever be due
+    return (next->key - stats->totalTicks + UserTick - 1) / UserTick;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTicks
+// 	Advance simulated time for a run of user instructions executed
+//	without calling OneTick.  The caller has checked with TicksUntilDue
+//	that no interrupt became due along the way, so all that is left of
+//	OneTick is the bookkeeping.
+//
+//	"ticks" -- the number of user instructions executed
+//----------------------------------------------------------------------
+
+void
+Interrupt::AdvanceUserTicks(int ticks)
+{
+    ASSERT(status == UserMode);
+    stats->totalTicks += ticks * UserTick;
+    stats->userTicks += ticks * UserTick;
 }
 
 //----------------------------------------------------------------------
@@ -199,6 +269,35 @@ Interrupt::YieldOnReturn()
     yieldOnReturn = TRUE; 
 }
 
+//----------------------------------------------------------------------
+// Interrupt::AbortOnReturn
+// 	Called from the ctl-C signal handler, to have Nachos clean up and
+//	quit.  The signal can come in the middle of anything -- a thread
+//	may be holding the disk, say -- so Cleanup is left to a thread of
+//	its own, started from OneTick or Idle, which can wait for the
+//	others to let go.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AbortOnReturn()
+{ 
+    abortOnReturn = TRUE; 
+}
+
+//----------------------------------------------------------------------
+// Interrupt::StartAbort
+// 	Fork the thread that cleans up after ctl-C.  Until Nachos quits,
+//	every other thread yields to it on each tick.
+//----------------------------------------------------------------------
+
+void
+Interrupt::StartAbort()
+{
+    abortOnReturn = FALSE;
+    aborter = new Thread("abort");
+    aborter->Fork(AbortThread, 0);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Idle
 // 	Routine called when there is nothing in the ready queue.
@@ -216,6 +315,11 @@ Interrupt::Idle()
 
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    if (abortOnReturn) {		// the user hit ctl-C; there is
+	StartAbort();			// now a thread to run
+	status = SystemMode;
+	return;
+    }
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -245,10 +349,13 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
-	//printf("tlb hit:%d\n", machine->tlbhit);
-	//printf("tlb miss:%d\n", machine->tlbmiss);
-	printf("page hit:%d\n", machine->pagehit);
-	printf("page miss:%d\n", machine->pagemiss);
+	if (machine->tlb != NULL) {
+		printf("tlb hit:%d\n", machine->pagehit);
+		printf("tlb miss:%d\n", machine->pagemiss);
+	} else {
+		printf("page hit:%d\n", machine->pagehit);
+		printf("page miss:%d\n", machine->pagemiss);
+	}
 	printf("rate:%f\n",(double)( machine->pagehit)/(machine->pagehit + machine->pagemiss));
     stats->Print();
     Cleanup();     // Never returns.
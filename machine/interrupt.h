@@ -38,6 +38,8 @@
 #include "copyright.h"
 #include "list.h"
 
+class Thread;
+
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
 
@@ -96,6 +98,8 @@ class Interrupt {
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
+    void AbortOnReturn();		// clean up and quit, once whatever
+					// was interrupted can be left
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
     void setStatus(MachineStatus st) { status = st; }
@@ -114,6 +118,11 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    int TicksUntilDue();		// How many user instructions can run
+					// before a pending interrupt is due?
+    void AdvanceUserTicks(int ticks);	// Charge for user instructions run
+					// without calling OneTick
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     List *pending;		// the list of interrupts scheduled
@@ -121,12 +130,17 @@ class Interrupt {
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
+    bool abortOnReturn;		// TRUE if the user hit ctl-C
+    Thread *aborter;		// the thread cleaning up after ctl-C,
+				// which every other thread yields to
     MachineStatus status;	// idle, kernel mode, user mode
 
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void StartAbort();			// Fork the thread to clean up
+					// after ctl-C
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
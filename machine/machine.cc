@@ -50,23 +50,47 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"how" -- which engine executes user instructions
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+// Size of user memory; set from the command line in Initialize
+int PageSize = DefaultPageSize;
+int NumPhysPages = DefaultNumPhysPages;
+int TLBSize = DefaultTLBSize;
+int TLBWays = DefaultTLBSize;
+
+Machine::Machine(bool debug, ExecEngine how)
 {
     int i;
 	flag = 0;
-	tlbmiss = 0;
-	tlbhit = 0;
 	pagemiss = 0;
 	pagehit = 0;
-	for(int i = 0; i < 4; i ++)
-		lasttime[i] = stats->totalTicks;
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodeValid[i] = FALSE;
+    pageDecoded = new bool[NumPhysPages];
+    pageLasttime = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++) {
+	pageDecoded[i] = FALSE;
+	pageLasttime[i] = 0;
+    }
+    stampReferences = TRUE;
+    blockAt = new TranslatedBlock *[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	blockAt[i] = NULL;
+    engine = how;
+    threadedHandlers = NULL;
+    blockGeneration = 0;
+    pendingTicks = 0;
+    fetchFrame = -1;
+    for (i = 0; i < SoftTLBSize; i++)
+	softTLB[i].tid = -1;
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -75,7 +99,7 @@ Machine::Machine(bool debug)
 	printf("create tlb!\n");
 #else	// use linear page table
     tlb = NULL;
-    pageTable = new TranslationEntry[32];
+    pageTable = new TranslationEntry[NumPhysPages];
 	for(i = 0; i < NumPhysPages; i ++)
 	{
 		pageTable[i].virtualPage = -1;
@@ -88,17 +112,10 @@ Machine::Machine(bool debug)
 	}
 #endif
 	//initialize inverted page table
-	/*
-	invertedPageTable = new InvertedPageTableEntry[32];
-	for(i = 0; i < 32; i ++)
-	{
-		invertedPageTable[i].vpn = 0;
-		invertedPageTable[i].tid = -1;
-		invertedPageTable[i].dirty = FALSE;
-		invertedPageTable[i].valid = FALSE;
-		invertedPageTable[i].readOnly = FALSE;
-	}
-	*/
+    if (pageTable != NULL)
+	invertedPageTable = new InvertedPageTable(pageTable, NumPhysPages);
+    else
+	invertedPageTable = NULL;
 /*
 printf("try to open disk\n");
 	bool succ = fileSystem->Create("disk",100);
@@ -118,8 +135,18 @@ printf("succ:%d\n", succ);
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete [] pageDecoded;
+    delete [] pageLasttime;
+    for (int i = 0; i < MemorySize / 4; i++)
+	if (blockAt[i] != NULL)
+	    delete blockAt[i];
+    delete [] blockAt;
     if (tlb != NULL)
         delete [] tlb;
+    if (invertedPageTable != NULL)
+	delete invertedPageTable;
 }
 
 //----------------------------------------------------------------------
@@ -140,6 +167,10 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    if (pendingTicks > 0) {		// the kernel must see the right time
+	interrupt->AdvanceUserTicks(pendingTicks);
+	pendingTicks = 0;
+    }
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
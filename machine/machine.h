@@ -26,15 +26,41 @@
 #include "translate.h"
 #include "disk.h"
 #include "openfile.h"
-// Definitions related to the size, and format of user memory
+// Definitions related to the size, and format of user memory.
+// The page size and the number of physical pages are chosen at startup
+// (see -ps and -pm in system.cc), before the machine is created.
 
-#define PageSize 	SectorSize 	// set the page size equal to
+#define DefaultPageSize	SectorSize 	// set the page size equal to
 					// the disk sector size, for
 					// simplicity
+#define DefaultNumPhysPages 32
 
-#define NumPhysPages    32
+extern int PageSize;			// bytes per page; a multiple of
+					// SectorSize
+extern int NumPhysPages;		// page frames in main memory
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define DefaultTLBSize	4		// if there is a TLB, make it small
+
+// The TLB is divided into sets of TLBWays entries; a virtual page can
+// only be cached in the set TLBSetOf(vpn), which starts at entry
+// TLBSetOf(vpn) * TLBWays.  Both sizes are chosen at startup (see -te
+// and -ta in system.cc).
+
+extern int TLBSize;			// entries in the TLB
+extern int TLBWays;			// entries per set; TLBSize if fully
+					// associative
+#define TLBSetOf(vpn)	((vpn) % (TLBSize / TLBWays))
+#define SoftTLBSize	256		// entries in the simulator's own
+					// translation cache; a power of 2
+#define SoftTLBIndex(tid, vpn)	(((vpn) ^ ((tid) << 4)) & (SoftTLBSize - 1))
+#define InstrsPerPage	(PageSize / 4)	// instruction words in one page
+#define MaxBlockLength	32		// longest basic block we translate
+
+// Ways of executing user instructions.  The switch engine decodes and
+// dispatches one instruction at a time; the threaded engine translates
+// basic blocks into a list of handler addresses (see blocksim.cc).
+
+enum ExecEngine { SwitchEngine, ThreadedEngine };
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -93,7 +119,41 @@ class Instruction {
 };
 
 
+// A translated basic block, for the threaded engine.  Each instruction
+// carries the address of the code that executes it, so running the
+// block never goes back through the big switch.  A block starts at any
+// instruction and runs to the first branch or jump (plus its delay slot),
+// a syscall, or the end of the physical page.
 
+class ThreadedInstr {
+  public:
+    void *handler;		// where the engine jumps to run this
+    Instruction instr;		// the decoded instruction
+};
+
+class TranslatedBlock {
+  public:
+    int frame;			// physical page the block lives in
+    int length;			// number of instructions in "code"
+    ThreadedInstr code[MaxBlockLength];
+};
+
+// An entry in the simulator's translation cache (not to be confused
+// with the simulated TLB).  Page table translations that succeed are
+// remembered here, keyed by (thread id, virtual page), so that most
+// loads and stores need just one lookup.  The user program can't tell
+// the cache is there, so an entry must be thrown away whenever the
+// page table entry it came from changes.
+
+class SoftTLBEntry {
+  public:
+    int tid;			// owner of the mapping, or -1 if unused
+    unsigned int vpn;		// virtual page
+    int frame;			// physical page it maps to
+    char *page;			// where that page is in "mainMemory"
+    bool readOnly;		// copied from the page table entry
+    TranslationEntry *entry;	// the entry, to set its use/dirty bits
+};
 
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
@@ -110,7 +170,8 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, ExecEngine how);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -122,16 +183,35 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 	int flag;
-	int tlbmiss;
-	int pagemiss;
-	int lasttime[4];
-	int pageLasttime[32];
-	int tlbhit;
-	int pagehit;
+	int pagemiss;		// translations that missed in the page
+	int pagehit;		// table or TLB, and that hit
+	int *pageLasttime;
+	bool stampReferences;	// keep pageLasttime up to date on every
+				// reference?  Only LRU needs it
 // Routines internal to the machine simulation -- DO NOT call these 
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    void ExecuteInstruction(Instruction *instr);
+				// Run an instruction that is already decoded
+    bool FetchInstruction(Instruction *instr);
+				// Fetch and decode the instruction at PC,
+				// going through the predecoded cache.
+				// Return FALSE if an exception occurred.
+    bool TranslatePC(int *physAddr);
+				// Translate PC for an instruction fetch
+    Instruction *DecodedAt(int physAddr);
+				// Decoded instruction at a physical address
+    void InvalidateDecodedPage(int frame);
+				// Forget predecoded instructions and blocks
+				// in a physical page whose contents changed
+
+    void RunThreaded();		// Run() for the threaded engine
+    TranslatedBlock *TranslateBlock(int physAddr);
+				// Build the block starting at "physAddr"
+    void ExecuteBlock(TranslatedBlock *block);
+				// Run a block until it ends, a branch is
+				// taken or an exception occurs
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -147,6 +227,13 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    char *FastTranslate(int virtAddr, int size, bool writing);
+				// Translate through the translation cache;
+				// NULL if Translate has to be called
+    void InvalidateTranslation(int tid, unsigned int vpn);
+				// A page table entry was changed
+    void FlushTranslations(int tid);
+				// A thread id is being given up
 	void LRU();
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -162,12 +249,17 @@ class Machine {
 // Note that *all* communication between the user program and the kernel 
 // are in terms of these data structures.
 
-	OpenFile *disk;
-	int diskPos;
     char *mainMemory;		// physical memory to store user program,
 				// code and data, while executing
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    Instruction *decodeCache;	// predecoded instructions, one slot per
+				// word of "mainMemory"
+    bool *decodeValid;		// is the matching decodeCache slot filled?
+    bool *pageDecoded;		// does a physical page have any filled slot?
+    TranslatedBlock **blockAt;	// block starting at each word of memory,
+				// or NULL if none has been translated
+
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -180,6 +272,9 @@ class Machine {
 // If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 //	the contents of the TLB.  But the kernel can use any data structure
 //	it wants (eg, segmented paging) for handling TLB cache misses.
+//	Each TLB entry is tagged ("tid") with the thread it belongs to, as
+//	an address space identifier, so the TLB need not be flushed on a
+//	context switch.
 // 
 // For simplicity, both the page table pointer and the TLB pointer are
 // public.  However, while there can be multiple page tables (one per address
@@ -192,12 +287,25 @@ class Machine {
 	
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
-	InvertedPageTableEntry *invertedPageTable;
+    InvertedPageTable *invertedPageTable;
+				// hash index over "pageTable"
   private:
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
+
+    ExecEngine engine;		// how to execute user instructions
+    void **threadedHandlers;	// handler address for each opcode
+    int blockGeneration;	// bumped whenever blocks are thrown away
+    int pendingTicks;		// user instructions run by the threaded
+				// engine but not yet charged to the clock
+
+    SoftTLBEntry softTLB[SoftTLBSize];	// the translation cache
+
+    int fetchTid;		// translation of the page we last fetched
+    unsigned int fetchVpn;	// an instruction from, so that straight-line
+    int fetchFrame;		// code skips Translate; -1 if not valid
 };
 
 extern void ExceptionHandler(ExceptionType which);
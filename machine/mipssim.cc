@@ -25,6 +25,9 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	With the threaded engine we hand off to RunThreaded, except when
+//	single-stepping or tracing instructions, which need the loop below.
 //----------------------------------------------------------------------
 
 void
@@ -36,6 +39,8 @@ Machine::Run()
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+    if (engine == ThreadedEngine && !singleStep && !DebugIsEnabled('m'))
+	RunThreaded();			// never returns
     for (;;) {
         OneInstruction(instr);
 	interrupt->OneTick();
@@ -93,16 +98,9 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
-
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if (!FetchInstruction(instr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -114,7 +112,28 @@ Machine::OneInstruction(Instruction *instr)
        printf("\n");
 
        }
-    
+    ExecuteInstruction(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute an instruction that has already been fetched and decoded,
+//	then do any pending delayed load and advance the program counters.
+//
+//	If the instruction causes an exception, we return without touching
+//	the PC, so that it is re-started after the kernel handles it.
+//
+//	This is also the fallback used by the threaded engine (blocksim.cc)
+//	for instructions it has no handler for.
+//----------------------------------------------------------------------
+
+void
+Machine::ExecuteInstruction(Instruction *instr)
+{
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -374,7 +393,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
 	break;
 	
       case OP_ORI:
@@ -626,6 +645,122 @@ Instruction::Decode()
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch the instruction at PC and decode it into "instr".
+//
+//	Decoded instructions are cached per word of physical memory, so
+//	a loop only pays for Decode the first time through.  We also
+//	remember the translation of the page we last fetched from; as long
+//	as the PC stays on that page we compute the physical address
+//	directly instead of searching the page table in Translate.  The
+//	page hit count and LRU timestamp are still updated, so paging
+//	behaves as if Translate had been called.
+//
+//	Returns FALSE if the fetch caused an exception.
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(Instruction *instr)
+{
+    int physAddr;
+
+    if (!TranslatePC(&physAddr))
+	return FALSE;
+    *instr = *DecodedAt(physAddr);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslatePC
+// 	Translate the current PC into a physical address for an
+//	instruction fetch, raising the exception if that fails.
+//
+//	Returns FALSE if an exception occurred.
+//
+//	"physAddr" -- the place to store the physical address
+//----------------------------------------------------------------------
+
+bool
+Machine::TranslatePC(int *physAddr)
+{
+    int pc = registers[PCReg];
+    unsigned int vpn = (unsigned) pc / PageSize;
+    ExceptionType exception;
+
+    if (fetchFrame >= 0 && vpn == fetchVpn && !(pc & 0x3)
+			&& fetchTid == currentThread->gettid()) {
+	*physAddr = fetchFrame * PageSize + (unsigned) pc % PageSize;
+	pagehit++;
+	if (stampReferences)
+	    pageLasttime[fetchFrame] = stats->totalTicks + pendingTicks;
+	return TRUE;
+    }
+    exception = Translate(pc, physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, pc);
+	return FALSE;
+    }
+    if (tlb == NULL) {			// TLB contents change behind our back
+	fetchTid = currentThread->gettid();
+	fetchVpn = vpn;
+	fetchFrame = *physAddr / PageSize;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodedAt
+// 	Return the decoded form of the instruction word at a physical
+//	address, decoding it into the cache if it isn't there yet.
+//
+//	"physAddr" -- word-aligned physical address of the instruction
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodedAt(int physAddr)
+{
+    int slot = physAddr / 4;
+    Instruction *instr = &decodeCache[slot];
+
+    if (decodeValid[slot]) {
+	stats->numDecodeHits++;
+	return instr;
+    }
+    stats->numDecodeMisses++;
+    instr->value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    instr->Decode();
+    decodeValid[slot] = TRUE;
+    pageDecoded[physAddr / PageSize] = TRUE;
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+// 	The contents or the mapping of a physical page changed, so any
+//	instruction we decoded from it may be stale.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int frame)
+{
+    int first = frame * InstrsPerPage;
+
+    for (int i = 0; i < InstrsPerPage; i++) {
+	decodeValid[first + i] = FALSE;
+	if (blockAt[first + i] != NULL) {
+	    delete blockAt[first + i];
+	    blockAt[first + i] = NULL;
+	}
+    }
+    pageDecoded[frame] = FALSE;
+    blockGeneration++;			// tell a running block to stop
+    if (frame == fetchFrame)
+	fetchFrame = -1;
+}
+
 //----------------------------------------------------------------------
 // Mult
 // 	Simulate R2000 multiplication.
@@ -22,6 +22,50 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCleanEvictions = numDirtyEvictions = numCopyOnWrites = 0;
+    numPagesPrefetched = numPrefetchesUnused = numClusteredReads = 0;
+    numFramesFreed = numFramesReclaimed = numFaultEvictions = 0;
+    numPagesTrimmed = numSuspensions = 0;
+    numSwapCacheStores = numSameValuePages = numSwapCacheRejects = 0;
+    numSwapCacheHits = numSwapCacheSpills = 0;
+    swapCacheBytesIn = swapCacheBytesOut = 0;
+    numBufferHits = numBufferMisses = numBufferWriteBacks = 0;
+    numDecodeHits = numDecodeMisses = 0;
+    numSoftTLBHits = numSoftTLBMisses = 0;
+    startClock = clock();
+    firstProcess = lastProcess = NULL;
+}
+
+//----------------------------------------------------------------------
+// ProcessStats::ProcessStats
+// 	Initialize a user program's metrics to zero, when it is started.
+//----------------------------------------------------------------------
+
+ProcessStats::ProcessStats()
+{
+    tid = -1;
+    numPageFaults = userTicks = 0;
+    peakResident = numSuspensions = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// Statistics::NewProcess
+// 	Return the metrics for a user program that is being started; they
+//	are printed, with everyone else's, at system shutdown.
+//----------------------------------------------------------------------
+
+ProcessStats *
+Statistics::NewProcess()
+{
+    ProcessStats *process = new ProcessStats();
+
+    if (lastProcess == NULL)
+	firstProcess = process;
+    else
+	lastProcess->next = process;
+    lastProcess = process;
+    return process;
 }
 
 //----------------------------------------------------------------------
@@ -38,7 +82,53 @@ Statistics::Print()
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, evictions clean %d, dirty %d\n",
+	numPageFaults, numCleanEvictions, numDirtyEvictions);
+    if (numCopyOnWrites > 0)
+	printf("Copy-on-write: pages copied %d\n", numCopyOnWrites);
+    if (numPagesPrefetched > 0)
+	printf("Fault-around: pages prefetched %d, unused %d, "
+		"multi-page swap reads %d\n", numPagesPrefetched,
+		numPrefetchesUnused, numClusteredReads);
+    if (numFramesFreed > 0)
+	printf("Page daemon: frames freed %d, reclaimed %d, "
+		"faults without a free frame %d\n", numFramesFreed,
+		numFramesReclaimed, numFaultEvictions);
+    if (numPagesTrimmed + numSuspensions > 0)
+	printf("Working sets: pages trimmed %d, processes suspended %d\n",
+		numPagesTrimmed, numSuspensions);
+    if (numSwapCacheStores + numSwapCacheRejects > 0)
+	printf("Swap cache: pages compressed %d (same-value %d) to %.1f%%, "
+		"incompressible %d, read back %d, spilled %d, "
+		"disk writes avoided %d\n", numSwapCacheStores,
+		numSameValuePages, swapCacheBytesIn == 0 ? 0.0 :
+		100.0 * swapCacheBytesOut / swapCacheBytesIn,
+		numSwapCacheRejects, numSwapCacheHits, numSwapCacheSpills,
+		numSwapCacheStores - numSwapCacheSpills);
+    if (numBufferHits + numBufferMisses + numBufferWriteBacks > 0)
+	printf("Buffer cache: hits %d, misses %d, hit rate %.2f%%, "
+		"write-backs %d\n", numBufferHits, numBufferMisses,
+		numBufferHits + numBufferMisses == 0 ? 0.0 :
+		100.0 * numBufferHits / (numBufferHits + numBufferMisses),
+		numBufferWriteBacks);
+    for (ProcessStats *p = firstProcess; p != NULL; p = p->next)
+	printf("Process %d: faults %d, user ticks %d, peak frames %d, "
+		"suspended %d\n", p->tid, p->numPageFaults, p->userTicks,
+		p->peakResident, p->numSuspensions);
+    if (numDecodeHits + numDecodeMisses > 0)
+	printf("Decode cache: hits %d, misses %d, hit rate %.2f%%\n",
+	    numDecodeHits, numDecodeMisses,
+	    100.0 * numDecodeHits / (numDecodeHits + numDecodeMisses));
+    if (numSoftTLBHits + numSoftTLBMisses > 0)
+	printf("Translation cache: hits %d, misses %d, hit rate %.2f%%\n",
+	    numSoftTLBHits, numSoftTLBMisses,
+	    100.0 * numSoftTLBHits / (numSoftTLBHits + numSoftTLBMisses));
+    if (userTicks > 0) {
+	double seconds = (double) (clock() - startClock) / CLOCKS_PER_SEC;
+	if (seconds > 0)
+	    printf("Throughput: %.0f user instructions per host second\n",
+		userTicks / seconds);
+    }
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
@@ -12,6 +12,22 @@
 #define STATS_H
 
 #include "copyright.h"
+#include <time.h>
+
+// Paging statistics for one user program (address space).  They are
+// kept after it exits, so that they can be printed at the end.
+
+class ProcessStats {
+  public:
+    ProcessStats();		// initialize everything to zero
+
+    int tid;			// the thread running it, once it has run
+    int numPageFaults;		// pages it had to have brought in
+    int userTicks;		// time spent executing its code
+    int peakResident;		// most page frames it had mapped at once
+    int numSuspensions;		// times it was swapped out to make room
+    ProcessStats *next;		// the next one started
+};
 
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
@@ -33,11 +49,41 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numCleanEvictions;	// pages thrown out without a write-back
+    int numDirtyEvictions;	// pages written back when thrown out
+    int numCopyOnWrites;	// shared pages copied because of a write
+    int numPagesPrefetched;	// pages brought in around a faulting one
+    int numPrefetchesUnused;	// of those, how many were thrown out unused
+    int numClusteredReads;	// swap reads of more than one page
+    int numFramesFreed;		// page frames freed by the page daemon
+    int numFramesReclaimed;	// of those, how many were faulted back
+    int numFaultEvictions;	// faults that found no free frame
+    int numPagesTrimmed;	// pages taken from processes faulting seldom
+    int numSuspensions;		// processes swapped out to make room
+    int numSwapCacheStores;	// pages compressed instead of written out
+    int numSameValuePages;	// of those, pages of one word repeated
+    int numSwapCacheRejects;	// pages that would not compress
+    int numSwapCacheHits;	// pages read back from the compressed pool
+    int numSwapCacheSpills;	// compressed pages written out after all
+    int swapCacheBytesIn;	// bytes of the pages compressed
+    int swapCacheBytesOut;	// bytes they were compressed to
+    int numBufferHits;		// sector reads served by the buffer cache
+    int numBufferMisses;	// sector reads that went to the disk
+    int numBufferWriteBacks;	// changed buffers written to the disk
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numDecodeHits;		// instruction fetches served predecoded
+    int numDecodeMisses;	// instruction fetches that had to Decode
+    int numSoftTLBHits;		// loads and stores translated by the
+    int numSoftTLBMisses;	// simulator's translation cache, or not
+    clock_t startClock;		// host CPU time when Nachos started
+    ProcessStats *firstProcess;	// every user program, in the order
+    ProcessStats *lastProcess;	// they were started
 
     Statistics(); 		// initialize everything to zero
 
+    ProcessStats *NewProcess();	// start keeping a user program's
+				// statistics
     void Print();		// print collected statistics
 };
 
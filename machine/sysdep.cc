@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -137,6 +138,8 @@ PollFile(int fd)
     retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
 #endif
 
+    if ((retVal < 0) && (errno == EINTR))
+	return FALSE;				// ctl-C came first; try again
     ASSERT((retVal == 0) || (retVal == 1));
     if (retVal == 0)
 	return FALSE;                 		// no char waiting to be read
@@ -241,6 +244,22 @@ Tell(int fd)
 #endif
 }
 
+//----------------------------------------------------------------------
+// FileNumber
+// 	Report a number identifying an open file: the same for every
+//	descriptor open on it, and different for every other file on the
+//	same file system.  Abort on error.
+//----------------------------------------------------------------------
+
+int 
+FileNumber(int fd)
+{
+    struct stat status;
+    int retVal = fstat(fd, &status);
+
+    ASSERT(retVal >= 0);
+    return (int) status.st_ino;
+}
 
 //----------------------------------------------------------------------
 // Close
@@ -7,7 +7,9 @@
 // Two types of translation are supported here.
 //
 //	Linear page table -- the virtual page # is used as an index
-//	into the table, to find the physical page #.
+//	into the table, to find the physical page #.  (Here, the table
+//	is an inverted one, shared by all threads and looked up through
+//	a hash index: see InvertedPageTable at the end of this file.)
 //
 //	Translation lookaside buffer -- associative lookup in the table
 //	to find an entry with the same virtual page #.  If found,
@@ -90,27 +92,32 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    char *host;
     
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+    host = FastTranslate(addr, size, FALSE);
+    if (host == NULL) {
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
     }
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = *host;
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) host;
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) host;
 	*value = WordToHost(data);
 	break;
 
@@ -139,27 +146,33 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *host;
      
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+    host = FastTranslate(addr, size, TRUE);
+    if (host == NULL) {
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
     }
+    if (pageDecoded[(host - mainMemory) / PageSize])	// self-modifying code
+	InvalidateDecodedPage((host - mainMemory) / PageSize);
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*host = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
+	*(unsigned short *) host
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	*(unsigned int *) host = WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
@@ -211,19 +224,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     if (tlb == NULL) {		// => page table => vpn is index into table
-		bool existPageFault = TRUE;
-		for(int i = 0; i <NumPhysPages; i ++)
-		{
-			if((currentThread->gettid() == (machine->pageTable[i]).tid) &&(machine->pageTable[i]).valid && ((machine->pageTable[i]).virtualPage == vpn)) 	
-			{
-				existPageFault = FALSE;
-				machine->pagehit ++;
-				entry = &(machine->pageTable[i]);
-				pageLasttime[(machine->pageTable[i]).physicalPage] = stats->totalTicks;
-
-			}
+		entry = invertedPageTable->Lookup(currentThread->gettid(), vpn);
+		if (entry != NULL) {
+			machine->pagehit ++;
+			if (stampReferences)
+				pageLasttime[entry->physicalPage] = stats->totalTicks + pendingTicks;
 		}
-	 if (existPageFault) {
+	 if (entry == NULL) {
 		printf("this is a pagefalut\n");
 		machine->pagemiss++;
 	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
@@ -232,16 +239,23 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
+	int tid = currentThread->gettid();	// address space identifier
+	int first = TLBSetOf(vpn) * TLBWays;	// only this set can hold it
+
+        for (entry = NULL, i = first; i < first + TLBWays; i++)
 	{
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
-		lasttime[i] = stats->totalTicks;
-		tlbhit ++;
+    	    if (tlb[i].valid && ((unsigned) tlb[i].virtualPage == vpn)
+			&& (tlb[i].tid == tid)) {
+		pagehit ++;
+		if (stampReferences)
+		    pageLasttime[tlb[i].physicalPage] =
+			    stats->totalTicks + pendingTicks;
 		entry = &tlb[i];			// FOUND!
 		break;
 	    }
 	}
 	if (entry == NULL) {				// not found
+	    pagemiss++;
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
@@ -257,15 +271,230 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) {
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
 	entry->dirty = TRUE;
+    if (tlb == NULL) {		// remember the translation for next time
+	SoftTLBEntry *cached =
+		&softTLB[SoftTLBIndex(currentThread->gettid(), vpn)];
+
+	cached->tid = currentThread->gettid();
+	cached->vpn = vpn;
+	cached->frame = pageFrame;
+	cached->page = &mainMemory[pageFrame * PageSize];
+	cached->readOnly = entry->readOnly;
+	cached->entry = entry;
+    }
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FastTranslate
+// 	Translate a virtual address using only the translation cache, for
+//	ReadMem and WriteMem.  Has the same effect as a successful call to
+//	Translate, but leaves anything unusual -- a miss, a misaligned
+//	address, or a write to a read-only page -- to Translate.  Only
+//	page table translations are cached, so with a TLB every lookup
+//	misses.
+//
+//	Returns where the data is in "mainMemory", or NULL if Translate
+//	has to be called instead.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- if TRUE, the page must be writable
+//----------------------------------------------------------------------
+
+char *
+Machine::FastTranslate(int virtAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    int tid = currentThread->gettid();
+    SoftTLBEntry *cached = &softTLB[SoftTLBIndex(tid, vpn)];
+
+    if ((cached->tid != tid) || (cached->vpn != vpn)) {
+	stats->numSoftTLBMisses++;
+	return NULL;
+    }
+    if ((virtAddr & (size - 1)) || (writing && cached->readOnly))
+	return NULL;			// let Translate raise the exception
+    stats->numSoftTLBHits++;
+    pagehit++;
+    if (stampReferences)
+	pageLasttime[cached->frame] = stats->totalTicks + pendingTicks;
+    cached->entry->use = TRUE;
+    if (writing)
+	cached->entry->dirty = TRUE;
+    return cached->page + (unsigned) virtAddr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateTranslation
+// 	Forget any cached translation of one virtual page, including the
+//	one TranslatePC keeps for instruction fetches and any TLB entry.
+//	Must be called whenever a page table entry is changed or reused.
+//	A block being run by the threaded engine fetches without looking
+//	the page up again, so it is told to stop.
+//
+//	"tid" -- the thread the entry belonged to
+//	"vpn" -- the virtual page it mapped
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateTranslation(int tid, unsigned int vpn)
+{
+    SoftTLBEntry *cached = &softTLB[SoftTLBIndex(tid, vpn)];
+
+    if ((cached->tid == tid) && (cached->vpn == vpn))
+	cached->tid = -1;
+    if ((fetchTid == tid) && (fetchVpn == vpn))
+	fetchFrame = -1;
+    blockGeneration++;
+    if (tlb != NULL) {
+	int first = TLBSetOf(vpn) * TLBWays;
+
+	for (int i = first; i < first + TLBWays; i++)
+	    if (tlb[i].valid && (tlb[i].tid == tid)
+			&& ((unsigned) tlb[i].virtualPage == vpn))
+		tlb[i].valid = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Forget every cached translation belonging to a thread, TLB entries
+//	included, because the thread is going away and its id may be
+//	handed out again.
+//
+//	"tid" -- the thread
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations(int tid)
+{
+    for (int i = 0; i < SoftTLBSize; i++)
+	if (softTLB[i].tid == tid)
+	    softTLB[i].tid = -1;
+    if (fetchTid == tid)
+	fetchFrame = -1;
+    blockGeneration++;
+    if (tlb != NULL)
+	for (int i = 0; i < TLBSize; i++)
+	    if (tlb[i].tid == tid)
+		tlb[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::InvertedPageTable
+// 	Set up an empty index over a table of translation entries.
+//
+//	"entries" -- the table, one entry per physical page
+//	"numEntries" -- how many entries there are
+//----------------------------------------------------------------------
+
+InvertedPageTable::InvertedPageTable(TranslationEntry *entries, int numEntries)
+{
+    int i;
+
+    table = entries;
+    for (numBuckets = 1; numBuckets < numEntries; numBuckets <<= 1)
+	;
+    bucket = new int[numBuckets];
+    for (i = 0; i < numBuckets; i++)
+	bucket[i] = -1;
+    next = new int[numEntries];
+    for (i = 0; i < numEntries; i++)
+	next[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::~InvertedPageTable
+// 	De-allocate the index.  The entries belong to the caller.
+//----------------------------------------------------------------------
+
+InvertedPageTable::~InvertedPageTable()
+{
+    delete [] bucket;
+    delete [] next;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Hash
+// 	Pick the bucket for a (thread, virtual page) pair.  Consecutive
+//	pages of one thread land in consecutive buckets, and different
+//	threads are spread apart.
+//----------------------------------------------------------------------
+
+int
+InvertedPageTable::Hash(int tid, unsigned int vpn)
+{
+    return (vpn + (unsigned int) tid * 0x9e3779b1) & (numBuckets - 1);
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Lookup
+// 	Find the valid translation of a virtual page for a thread.
+//
+//	"tid" -- the thread
+//	"vpn" -- the virtual page
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Lookup(int tid, unsigned int vpn)
+{
+    TranslationEntry *entry;
+
+    for (int i = bucket[Hash(tid, vpn)]; i != -1; i = next[i]) {
+	entry = &table[i];
+	if ((entry->tid == tid) && ((unsigned) entry->virtualPage == vpn)
+		&& entry->valid)
+	    return entry;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Insert
+// 	Index an entry under its current tid and virtual page.
+//
+//	"entry" -- the entry, which must not already be in the index
+//----------------------------------------------------------------------
+
+void
+InvertedPageTable::Insert(TranslationEntry *entry)
+{
+    int i = entry - table;
+    int b = Hash(entry->tid, entry->virtualPage);
+
+    next[i] = bucket[b];
+    bucket[b] = i;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Remove
+// 	Take an entry out of the index, so that its tid or virtual page
+//	can be changed.
+//
+//	"entry" -- the entry, which must be in the index
+//----------------------------------------------------------------------
+
+void
+InvertedPageTable::Remove(TranslationEntry *entry)
+{
+    int i = entry - table;
+    int *link = &bucket[Hash(entry->tid, entry->virtualPage)];
+
+    while (*link != i) {
+	ASSERT(*link != -1);
+	link = &next[*link];
+    }
+    *link = next[i];
+    next[i] = -1;
+}
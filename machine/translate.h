@@ -43,13 +43,37 @@ class TranslationEntry {
 	int tid;
 };
 
-#endif
-class InvertedPageTableEntry
-{
-public:
-	int vpn;//virtual page number
-	int tid;//thread id
-	bool dirty;//dirty bit
-	bool valid;//valid bit
-	bool readOnly;//readonly bit
+// The following class defines a hash index over a table of translation
+// entries, one per physical page, that are shared by all threads and
+// tagged with the thread that owns them (an "inverted" page table).
+// Finding the entry for a (thread, virtual page) pair takes one hash
+// probe, however many physical pages there are.
+//
+// The entries themselves live in the table that is passed in; this
+// class only keeps, for each hash bucket, a chain of entry numbers.
+// An entry must be removed from the index before its tid or virtual page
+// is changed, and inserted again afterwards.
+
+class InvertedPageTable {
+  public:
+    InvertedPageTable(TranslationEntry *entries, int numEntries);
+    ~InvertedPageTable();
+
+    TranslationEntry *Lookup(int tid, unsigned int vpn);
+				// Return the valid entry mapping "vpn" for
+				// thread "tid", or NULL if there is none
+    void Insert(TranslationEntry *entry);
+				// Index an entry under its tid and page
+    void Remove(TranslationEntry *entry);
+				// Take an entry out of the index
+
+  private:
+    int Hash(int tid, unsigned int vpn);
+
+    TranslationEntry *table;	// the entries being indexed
+    int numBuckets;		// a power of 2, at least the number of entries
+    int *bucket;		// first entry in each chain, or -1
+    int *next;			// next entry in the same chain, or -1
 };
+
+#endif
@@ -0,0 +1,48 @@
+/* fork.c 
+ *    Test program for copy-on-write Fork.
+ *
+ *    The parent fills an array, forks, and then each of parent and
+ *    child changes every element in its own way.  Each exits with the
+ *    sum of the array as it sees it: 3 * 130816 = 392448 for the
+ *    parent, 130816 + 512000 = 642816 for the child, whichever order
+ *    the writes happen in.
+ */
+
+#include "syscall.h"
+
+#define N 512
+
+int A[N];	/* several pages, all shared just after the Fork */
+
+int
+Sum()
+{
+    int i, sum = 0;
+
+    for (i = 0; i < N; i++)
+	sum += A[i];
+    return sum;
+}
+
+void
+Child()
+{
+    int i;
+
+    for (i = 0; i < N; i++)
+	A[i] += 1000;
+    Exit(Sum());
+}
+
+int
+main()
+{
+    int i;
+
+    for (i = 0; i < N; i++)
+	A[i] = i;
+    Fork(Child);
+    for (i = 0; i < N; i++)
+	A[i] *= 3;
+    Exit(Sum());
+}
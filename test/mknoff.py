@@ -0,0 +1,96 @@
+# mknoff.py
+#	Hand-assemble small NOFF test programs, for trees where the MIPS
+#	cross compiler is not available.
+#
+#	forktest -- the same program as fork.c.  The parent exits with
+#		    392448, the child with 642816.
+#	exec3	 -- Execs ../test/matmult three times, then exits with 0.
+#		    Each matmult exits with 7220.  Run it from a build
+#		    directory, as in "nachos -x ../test/exec3".
+#	badload	 -- loads from 0x01000000, beyond any address space.  The
+#		    program should be ended, and Nachos halt normally.
+#
+#	Usage: python3 mknoff.py [program ...]	(default: all of them)
+
+import struct, sys
+
+# MIPS registers and the instructions we need
+
+zero, v0, a0, t0, t1, t2, t3, t4, s1 = 0, 2, 4, 8, 9, 10, 11, 12, 17
+NOP = 0
+SYSCALL = 0xc
+SC_Exit, SC_Exec, SC_Fork = 1, 2, 9		# from ../userprog/syscall.h
+
+def I(op, rs, rt, imm): return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xffff)
+def R(rs, rt, rd, funct): return (rs << 21) | (rt << 16) | (rd << 11) | funct
+
+def addiu(rt, rs, imm): return I(9, rs, rt, imm)
+def lui(rt, imm): return I(15, 0, rt, imm)
+def lw(rt, off, rs): return I(35, rs, rt, off)
+def sw(rt, off, rs): return I(43, rs, rt, off)
+def addu(rd, rs, rt): return R(rs, rt, rd, 0x21)
+def bne(rs, rt, target, pc): return I(5, rs, rt, (target - (pc + 4)) // 4)
+
+def noff(code, data=b'', bss=0, base=0x100):
+    # NoffHeader: magic, then code, initData and uninitData segments,
+    # each as virtualAddr, inFileAddr, size.  Code is at 0, the data
+    # (if any) right after it at "base", the bss after that.
+    cb = b''.join(struct.pack('<I', c) for c in code)
+    assert len(cb) <= base
+    if data:
+        cb = cb.ljust(base, b'\0')
+    hdr = struct.pack('<10i', 0xbadfad,
+                      0, 40, len(cb),
+                      base if data else 0, 40 + len(cb) if data else 0, len(data),
+                      base + len(data), 0, bss)
+    return hdr + cb + data
+
+def forktest():
+    N, A = 512, 0x100			# int A[N], just past the code
+    code = []
+    def emit(x): code.append(x)
+    def here(): return len(code) * 4
+
+    def update_and_exit(body):
+        # for i in 0..N-1: A[i] = body(A[i]); Exit(Sum())
+        emit(addiu(t0, zero, A)); emit(addiu(t1, zero, 0))
+        L = here(); emit(lw(t3, 0, t0)); emit(NOP)
+        for ins in body:
+            emit(ins)
+        emit(sw(t3, 0, t0)); emit(addiu(t0, t0, 4)); emit(addiu(t1, t1, 1))
+        emit(bne(t1, t2, L, here())); emit(NOP)
+        emit(addiu(t0, zero, A)); emit(addiu(t1, zero, 0)); emit(addiu(s1, zero, 0))
+        L = here(); emit(lw(t3, 0, t0)); emit(NOP); emit(addu(s1, s1, t3))
+        emit(addiu(t0, t0, 4)); emit(addiu(t1, t1, 1))
+        emit(bne(t1, t2, L, here())); emit(NOP)
+        emit(addu(a0, s1, zero)); emit(addiu(v0, zero, SC_Exit)); emit(SYSCALL); emit(NOP)
+
+    # for i in 0..N-1: A[i] = i
+    emit(addiu(t0, zero, A)); emit(addiu(t1, zero, 0)); emit(addiu(t2, zero, N))
+    L = here(); emit(sw(t1, 0, t0)); emit(addiu(t0, t0, 4)); emit(addiu(t1, t1, 1))
+    emit(bne(t1, t2, L, here())); emit(NOP)
+    fork = len(code); emit(NOP)		# a0 = Child, filled in below
+    emit(addiu(v0, zero, SC_Fork)); emit(SYSCALL)
+    update_and_exit([addu(t4, t3, t3), addu(t3, t4, t3)])	# A[i] *= 3
+    code[fork] = addiu(a0, zero, here())
+    update_and_exit([addiu(t3, t3, 1000)])			# A[i] += 1000
+    return noff(code, bss=N * 4)
+
+def exec3():
+    name = b'../test/matmult\0'
+    code = []
+    for k in range(3):
+        code += [addiu(a0, zero, 0x100), addiu(v0, zero, SC_Exec), SYSCALL, NOP]
+    code += [addiu(a0, zero, 0), addiu(v0, zero, SC_Exit), SYSCALL, NOP]
+    return noff(code, data=name)
+
+def badload():
+    code = [lui(t0, 0x100), lw(t1, 0, t0), NOP,
+            addiu(v0, zero, SC_Exit), SYSCALL, NOP]
+    return noff(code, bss=256)
+
+programs = {'forktest': forktest, 'exec3': exec3, 'badload': badload}
+
+for name in sys.argv[1:] or sorted(programs):
+    with open(name, 'wb') as f:
+        f.write(programs[name]())
@@ -9,8 +9,13 @@
 // 	Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
+//		-s -E <engine> -pm <pages> -ps <bytes> -P <policy>
+//		-te <entries> -ta <ways> -tp <policy> -tm <ticks>
+//		-fa <pages> -fp <policy> -pd <low> <high> -ws <ticks>
+//		-sc <pages>
+//		-x <nachos file> -c <consoleIn> <consoleOut> -pt -bt
+//		-lt <nachos file>
+//		-f -bc <sectors> -at <policy> -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
@@ -22,11 +27,53 @@
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -E selects how user instructions are run: "switch" (the default)
+//	 decodes each one, "threaded" runs translated basic blocks
+//    -pm sets the number of physical page frames (default 32)
+//    -ps sets the page size in bytes, a multiple of the sector size
+//	 (default 128)
+//    -P selects the page replacement policy, "lru" (the default) or
+//	 "clock"
+//    -te sets the number of TLB entries (default 4)
+//    -ta sets the TLB associativity (default fully associative)
+//    -tp selects which entry of a TLB set to replace: "lru" (the
+//	 default), "fifo" or "random"
+//    -tm sets the time charged for refilling the TLB on a miss
+//	 (default 0)
+//    -fa sets how many pages after a faulting one are brought in with
+//	 it, if there are free or cold frames for them (default 0)
+//    -fp selects how the fault-around window is sized: "fixed" (the
+//	 default) always uses -fa pages, "adaptive" starts at none and
+//	 doubles, up to -fa, while the program faults sequentially
+//    -pd starts a page daemon, which frees page frames in the background
+//	 whenever fewer than <low> are free, until <high> are (default
+//	 none; page faults free frames themselves)
+//    -ws gives each program its own set of page frames, sized by how
+//	 often it faults: one that faults again within <ticks> of its own
+//	 running time gets another frame, suspending another program if
+//	 memory is full, while one that faults less often gives back the
+//	 pages it has not used since its last fault (default 0: programs
+//	 take frames from each other as they please)
+//    -sc compresses pages on their way to swap, and keeps them in as
+//	 much memory as <pages> uncompressed pages would take, writing
+//	 the oldest to the swap disk when it fills (default 0: every page
+//	 goes to the disk)
 //    -x runs a user program
 //    -c tests the console
+//    -pt times page table lookups for several memory sizes
+//    -bt times finding and counting clear bits in large bitmaps
+//    -lt times loading a user program, without running it
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -bc keeps up to <sectors> recently used disk sectors in memory,
+//	 writing changed ones back when their buffer is reused and at
+//	 the end (default 0: every read and write goes to the disk)
+//    -at sets when a file's visit and modify times are stamped: "strict"
+//	 (on every open, read and write, writing the header to disk each
+//	 time), "relatime" (the visit time only if the file was written
+//	 since, or a day has passed; headers are written when closed or
+//	 synced), or "noatime" (never the visit time) (default relatime)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
@@ -62,6 +109,7 @@ extern int testnum;
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void PageTableTest(void), BitMapTest(void), LoadTest(char *file);
 extern void MailTest(int networkID);
 extern void Printhello(void);
 //----------------------------------------------------------------------
@@ -130,7 +178,15 @@ int temp_argc = argc;
 	    interrupt->Halt();		// once we start the console, then 
 					// Nachos will loop forever waiting 
 					// for console input
-		}
+		} else if (!strcmp(*argv, "-pt")) {	// time page table lookups
+	    PageTableTest();
+	} else if (!strcmp(*argv, "-bt")) {	// time bitmap searches
+	    BitMapTest();
+	} else if (!strcmp(*argv, "-lt")) {	// time program loading
+	    ASSERT(argc > 1);
+	    LoadTest(*(argv + 1));
+	    argCount = 2;
+	}
 #endif // USER_PROGRAM
 
 #ifdef FILESYS
@@ -121,8 +121,8 @@ void Lock::Release()
 	
 	if(isHeldByCurrentThread())
 	{
-		semaphore->V();
-		threadHoldTheLock = NULL;
+		threadHoldTheLock = NULL;	// before V, which can let the
+		semaphore->V();			// next holder in
 	}
 }
 bool Lock::isHeldByCurrentThread()
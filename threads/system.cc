@@ -25,11 +25,23 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+HeaderTable *headerTable;
+TimeUpdate timeUpdate = TimeRelaxed;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
 BitMap *memBitMap;
+ReplacementPolicy *replacementPolicy;
+FrameInfo *coreMap;
+SwapDisk *swapDisk;
+TLBReplacement tlbReplacement = TLBReplaceLRU;
+int tlbMissTicks = 0;
+int faultAround = 0;
+bool faultAroundAdaptive = FALSE;
+int freeFramesLow = 0;
+int freeFramesHigh = 0;
+int pffInterval = 0;
 #endif
 
 #ifdef NETWORK
@@ -74,6 +86,18 @@ TimerInterruptHandler(int dummy)
 
 }
 
+//----------------------------------------------------------------------
+// UserAbort
+// 	Called when the user hits ctl-C.  Have the interrupt code start
+//	the cleanup as soon as it safely can; a second ctl-C quits at once.
+//----------------------------------------------------------------------
+static void
+UserAbort()
+{
+    CallOnUserAbort(NULL);
+    interrupt->AbortOnReturn();
+}
+
 //----------------------------------------------------------------------
 // Initialize
 // 	Initialize Nachos global data structures.  Interpret command
@@ -92,10 +116,17 @@ Initialize(int argc, char **argv)
     bool randomYield = FALSE;
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    ExecEngine engine = SwitchEngine;	// how to run user instructions
+    char *policy = "lru";		// page replacement policy
+    int tlbWays = 0;			// 0 means fully associative
+    int swapPoolPages = 0;		// compressed swap pool, in pages
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    int diskBuffers = 0;	// sectors the disk keeps in memory
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -120,12 +151,103 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-E")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "threaded"))
+		engine = ThreadedEngine;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "switch"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pm")) {
+	    ASSERT(argc > 1);
+	    NumPhysPages = atoi(*(argv + 1));	// physical memory, in pages
+	    ASSERT(NumPhysPages > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ps")) {
+	    ASSERT(argc > 1);
+	    PageSize = atoi(*(argv + 1));	// page size, in bytes
+	    ASSERT(PageSize > 0 && PageSize % SectorSize == 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-P")) {
+	    ASSERT(argc > 1);
+	    policy = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-te")) {
+	    ASSERT(argc > 1);
+	    TLBSize = atoi(*(argv + 1));	// TLB entries
+	    ASSERT(TLBSize > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ta")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));	// TLB associativity
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tp")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		tlbReplacement = TLBReplaceFIFO;
+	    else if (!strcmp(*(argv + 1), "random"))
+		tlbReplacement = TLBReplaceRandom;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "lru"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tm")) {
+	    ASSERT(argc > 1);
+	    tlbMissTicks = atoi(*(argv + 1));	// TLB miss penalty
+	    ASSERT(tlbMissTicks >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-fa")) {
+	    ASSERT(argc > 1);
+	    faultAround = atoi(*(argv + 1));	// fault-around window
+	    ASSERT(faultAround >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-fp")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "adaptive"))
+		faultAroundAdaptive = TRUE;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "fixed"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pd")) {
+	    ASSERT(argc > 2);
+	    freeFramesLow = atoi(*(argv + 1));	// page daemon watermarks
+	    freeFramesHigh = atoi(*(argv + 2));
+	    ASSERT(freeFramesLow > 0 && freeFramesLow <= freeFramesHigh);
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-ws")) {
+	    ASSERT(argc > 1);
+	    pffInterval = atoi(*(argv + 1));	// page fault frequency limit
+	    ASSERT(pffInterval >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-sc")) {
+	    ASSERT(argc > 1);
+	    swapPoolPages = atoi(*(argv + 1));	// compressed swap pool
+	    ASSERT(swapPoolPages >= 0);
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
-
+#ifdef FILESYS
+	else if (!strcmp(*argv, "-bc")) {
+	    ASSERT(argc > 1);
+	    diskBuffers = atoi(*(argv + 1));	// disk buffer cache size
+	    ASSERT(diskBuffers >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-at")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "strict"))
+		timeUpdate = TimeStrict;
+	    else if (!strcmp(*(argv + 1), "relatime"))
+		timeUpdate = TimeRelaxed;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "noatime"));
+		timeUpdate = TimeNoVisit;
+	    }
+	    argCount = 2;
+	}
+#endif
 
 #endif
 #ifdef NETWORK
@@ -158,17 +280,43 @@ Initialize(int argc, char **argv)
     currentThread->setStatus(RUNNING);
 	
     interrupt->Enable();
-    CallOnUserAbort(Cleanup);			// if user hits ctl-C
+    CallOnUserAbort(UserAbort);			// if user hits ctl-C
     	
 #ifdef USER_PROGRAM
-	memBitMap = new BitMap(32);
+	TLBWays = (tlbWays == 0) ? TLBSize : tlbWays;
+    ASSERT(TLBWays > 0 && TLBSize % TLBWays == 0);
+	memBitMap = new BitMap(NumPhysPages);
+    coreMap = new FrameInfo[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++) {
+	coreMap[i].page = NULL;
+	coreMap[i].space = NULL;
+	coreMap[i].entry = NULL;
+    }
+    swapDisk = new SwapDisk("SWAPDISK", swapPoolPages * PageSize);
+    if (!strcmp(policy, "clock"))
+	replacementPolicy = new ClockPolicy();
+    else {
+	ASSERT(!strcmp(policy, "lru"));
+	replacementPolicy = new LRUPolicy();
+    }
 
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, engine);	// this must come first
+    // The clock policy goes by use bits; the time of every reference is
+    // only wanted by LRU replacement, of page frames or of TLB entries,
+    // and by -ws, which trims the pages not used since the last fault.
+    machine->stampReferences = !strcmp(policy, "lru")
+	|| ((machine->tlb != NULL) && (tlbReplacement == TLBReplaceLRU))
+	|| (pffInterval > 0);
+    if (freeFramesHigh > 0) {
+	ASSERT(freeFramesHigh < NumPhysPages);
+	StartPageDaemon();
+    }
 	
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", diskBuffers);
+    headerTable = new HeaderTable();
 	
 #endif
 
@@ -190,12 +338,23 @@ void
 Cleanup()
 {
     printf("\nCleaning up...\n");
+#ifdef FILESYS
+    // Write back what the file system has put off writing, while there
+    // are still threads and a machine to wait for the disk with.  The
+    // thread that just finished, if that is us, has to be kept alive
+    // through the context switches this may take.
+    if (threadToBeDestroyed == currentThread)
+	threadToBeDestroyed = NULL;
+    fileSystem->Sync();
+#endif
 #ifdef NETWORK
     delete postOffice;
 #endif
     
 #ifdef USER_PROGRAM
     delete machine;
+    delete replacementPolicy;
+    delete swapDisk;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -203,6 +362,7 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete headerTable;
     delete synchDisk;
 #endif
     
@@ -35,6 +35,22 @@ extern Timer *timer;				// the hardware alarm clock
 extern Machine* machine;	// user program memory and registers
 #include "bitmap.h"
 extern BitMap* memBitMap;
+#include "replace.h"
+extern ReplacementPolicy *replacementPolicy;	// picks pages to evict
+extern FrameInfo *coreMap;	// what each page frame holds
+#include "swapdisk.h"
+extern SwapDisk *swapDisk;	// where pages go when thrown out
+
+// How the kernel picks a TLB entry to replace within a set
+enum TLBReplacement { TLBReplaceLRU, TLBReplaceFIFO, TLBReplaceRandom };
+extern TLBReplacement tlbReplacement;
+extern int tlbMissTicks;	// time the kernel takes to refill the TLB
+extern int faultAround;		// most pages to bring in after a fault
+extern bool faultAroundAdaptive;	// only as many as seem to be needed?
+extern int freeFramesLow;	// the page daemon runs when fewer are free,
+extern int freeFramesHigh;	// until this many are; 0 if there is none
+extern int pffInterval;		// a program faulting more often than this
+				// gets more frames; 0 for global replacement
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -45,6 +61,9 @@ extern FileSystem  *fileSystem;
 #ifdef FILESYS
 #include "synchdisk.h"
 extern SynchDisk   *synchDisk;
+#include "filehdr.h"
+extern HeaderTable *headerTable;	// headers of the files in use
+extern TimeUpdate timeUpdate;	// how eagerly file times are stamped
 #endif
 
 #ifdef NETWORK
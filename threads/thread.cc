@@ -84,6 +84,9 @@ Thread::~Thread()
 	//Vector
 	//deallocate thread id
 	threadMap[this->tid] = false;
+#ifdef USER_PROGRAM
+    machine->FlushTranslations(tid);	// the id may be handed out again
+#endif
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
 }
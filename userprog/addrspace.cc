@@ -18,7 +18,7 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
+#include "synch.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -45,6 +45,274 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// ReadSegment
+// 	Copy the part of a segment that falls within one virtual page
+//	from the executable into a page frame.
+//
+//	"executable" -- the file containing the object code
+//	"segment" -- where the segment is, in the file and in memory
+//	"vpn" -- the virtual page being filled
+//	"into" -- the page frame
+//----------------------------------------------------------------------
+
+static void
+ReadSegment(OpenFile *executable, Segment *segment, unsigned int vpn,
+		char *into)
+{
+    int pageStart = vpn * PageSize;
+    int start = max(segment->virtualAddr, pageStart);
+    int end = min(segment->virtualAddr + segment->size, pageStart + PageSize);
+
+    if ((segment->size > 0) && (start < end))
+	executable->ReadAt(into + (start - pageStart), end - start,
+		segment->inFileAddr + (start - segment->virtualAddr));
+}
+
+static Executable *executables = NULL;	// those in use, by any space
+
+//----------------------------------------------------------------------
+// Executable::Open
+// 	Find the Executable for an object code file, among those some
+//	address space is using, or make a new one.  A file is known by the
+//	sector holding its header, so it does not matter how it was
+//	opened.  The caller gets a reference to the Executable.
+//
+//	"file" -- the open executable; it now belongs to us
+//----------------------------------------------------------------------
+
+Executable *
+Executable::Open(OpenFile *file)
+{
+    Executable *exe;
+    int sector = file->HeaderSector();
+
+    for (exe = executables; exe != NULL; exe = exe->next)
+	if (exe->sector == sector) {
+	    delete file;			// we have it open already
+	    exe->refs++;
+	    return exe;
+	}
+    exe = new Executable(file);
+    exe->next = executables;
+    executables = exe;
+    exe->refs++;
+    return exe;
+}
+
+//----------------------------------------------------------------------
+// Executable::Close
+// 	An address space is done with the executable.  When the last one
+//	is, the file is closed and the code pages go away.
+//----------------------------------------------------------------------
+
+void
+Executable::Close()
+{
+    Executable **prev;
+
+    if (--refs > 0)
+	return;
+    for (prev = &executables; *prev != this; prev = &(*prev)->next)
+	;
+    *prev = next;
+    delete this;
+}
+
+//----------------------------------------------------------------------
+// Executable::Executable
+// 	Read the header of a NOFF object code file, and set up the code
+//	pages; like any page, they are brought in when they are touched.
+//
+//	"openFile" -- the open executable; it now belongs to us
+//----------------------------------------------------------------------
+
+Executable::Executable(OpenFile *openFile)
+{
+    file = openFile;
+    file->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) && 
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    sector = file->HeaderSector();
+    refs = 0;
+
+// a page shared by code and data has to stay writable
+    codeFirst = divRoundUp(noffH.code.virtualAddr, PageSize);
+    codeEnd = (noffH.code.virtualAddr + noffH.code.size) / PageSize;
+    if (codeEnd < codeFirst)
+	codeEnd = codeFirst;
+    text = new Page *[codeEnd - codeFirst];
+    for (unsigned int i = 0; i < codeEnd - codeFirst; i++)
+	text[i] = new Page();
+}
+
+//----------------------------------------------------------------------
+// Executable::~Executable
+// 	Close the file; no address space needs it any more.
+//----------------------------------------------------------------------
+
+Executable::~Executable()
+{
+    for (unsigned int i = 0; i < codeEnd - codeFirst; i++)
+	ReleasePage(text[i]);
+    delete [] text;
+    delete file;
+}
+
+//----------------------------------------------------------------------
+// Page::Page
+// 	Initialize a page that has just been touched for the first time.
+//----------------------------------------------------------------------
+
+Page::Page()
+{
+    frame = -1;
+    swapSlot = -1;
+    dirty = FALSE;
+    prefetched = FALSE;
+    refs = 1;
+}
+
+//----------------------------------------------------------------------
+// Page::~Page
+// 	The last address space using the page is done with it.
+//----------------------------------------------------------------------
+
+Page::~Page()
+{
+    if (swapSlot >= 0)
+	swapDisk->Free(swapSlot);
+}
+
+//----------------------------------------------------------------------
+// UnmapFrame
+// 	Remove the translation mapping a page frame, if there is one.  The
+//	page stays in the frame; whether it was written through the
+//	translation is remembered in the page.
+//
+//	"frame" -- the page frame
+//----------------------------------------------------------------------
+
+void
+UnmapFrame(int frame)
+{
+    TranslationEntry *entry = coreMap[frame].entry;
+
+    if (entry == NULL)
+	return;
+    machine->InvalidateTranslation(entry->tid, entry->virtualPage);
+    if (machine->invertedPageTable != NULL)
+	machine->invertedPageTable->Remove(entry);
+    if (entry->dirty)
+	coreMap[frame].page->dirty = TRUE;
+    entry->valid = FALSE;
+    entry->use = FALSE;
+    entry->tid = -1;
+    coreMap[frame].space->numResident--;
+    coreMap[frame].space = NULL;
+    coreMap[frame].entry = NULL;
+}
+
+//----------------------------------------------------------------------
+// SavePage
+// 	Write a modified page from its page frame to swap.  The page gets
+//	a slot on the swap disk the first time this happens, and keeps it
+//	until it is deleted.  The slot is put next to a neighbouring
+//	page's if possible, so that both can be read back in one go.
+//
+//	"page" -- the page, which must be in memory and unmapped
+//	"near" -- the slot to use if it is free, or -1
+//----------------------------------------------------------------------
+
+void
+SavePage(Page *page, int near)
+{
+    ASSERT(page->frame >= 0);
+    if (page->swapSlot < 0) {
+	page->swapSlot = swapDisk->Allocate(near);
+	ASSERT(page->swapSlot >= 0);		// out of swap space
+    }
+    swapDisk->WritePage(page->swapSlot,
+		&(machine->mainMemory[page->frame * PageSize]));
+    page->dirty = FALSE;
+}
+
+//----------------------------------------------------------------------
+// SavePages
+// 	Write several modified pages to swap at once.  Pages without a
+//	slot get one next to a neighbouring page's, or else next to the
+//	page before them in the batch, so that the slots run on; then
+//	each run of consecutive slots is written with one WritePages.
+//	"pages" is left sorted by slot.
+//
+//	"pages" -- the pages, which must be in memory and unmapped
+//	"near" -- for each, the slot to use if it is free, or -1
+//	"count" -- how many there are
+//----------------------------------------------------------------------
+
+void
+SavePages(Page **pages, int *near, int count)
+{
+    Page *page;
+    char *buffer;
+    int i, j, run;
+
+    for (i = 0; i < count; i++)
+	if (pages[i]->swapSlot < 0) {
+	    if ((near[i] < 0) && (i > 0))
+		near[i] = pages[i - 1]->swapSlot + 1;
+	    pages[i]->swapSlot = swapDisk->Allocate(near[i]);
+	    ASSERT(pages[i]->swapSlot >= 0);	// out of swap space
+	}
+    for (i = 1; i < count; i++) {		// few enough to insert
+	page = pages[i];
+	for (j = i; (j > 0) && (pages[j - 1]->swapSlot > page->swapSlot); j--)
+	    pages[j] = pages[j - 1];
+	pages[j] = page;
+    }
+
+    buffer = new char[count * PageSize];
+    for (i = 0; i < count; i += run) {
+	for (run = 1; i + run < count; run++)
+	    if (pages[i + run]->swapSlot != pages[i]->swapSlot + run)
+		break;
+	for (j = 0; j < run; j++) {
+	    page = pages[i + j];
+	    ASSERT(page->frame >= 0);
+	    bcopy(&(machine->mainMemory[page->frame * PageSize]),
+			&buffer[j * PageSize], PageSize);
+	    page->dirty = FALSE;
+	}
+	swapDisk->WritePages(pages[i]->swapSlot, run, buffer);
+    }
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// ReleasePage
+// 	An address space no longer uses a page.  If nobody else does, its
+//	page frame and swap slot are given back.
+//
+//	"page" -- the page
+//----------------------------------------------------------------------
+
+void
+ReleasePage(Page *page)
+{
+    int frame = page->frame;
+
+    if (--page->refs > 0)
+	return;
+    if (frame >= 0) {
+	UnmapFrame(frame);
+	coreMap[frame].page = NULL;
+	memBitMap->Clear(frame);
+    }
+    delete page;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -53,26 +321,24 @@ SwapHeader (NoffHeader *noffH)
 //
 //	Assumes that the object code file is in NOFF format.
 //
-//	First, set up the translation from program memory to physical 
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	Nothing is loaded here.  We only record the layout of the
+//	program, so that page faults can bring its pages in as they are
+//	touched; starting a program costs the same whatever its size.
 //
-//	"executable" is the file containing the object code to load into memory
+//	"executable" is the file containing the object code to load into
+//	memory; it stays open until the address space is deleted
 //----------------------------------------------------------------------
 
 AddrSpace::AddrSpace(OpenFile *executable)
 {
-    NoffHeader noffH;
     unsigned int i, size;
+    NoffHeader *noffH;
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    exe = Executable::Open(executable);
+    noffH = &exe->noffH;
 
 // how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
+    size = noffH->code.size + noffH->initData.size + noffH->uninitData.size 
 			+ UserStackSize;	// we need to increase the size
 						// to leave room for the stack
     numPages = divRoundUp(size, PageSize);
@@ -85,6 +351,43 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
+
+    codeFirst = exe->codeFirst;
+    codeEnd = exe->codeEnd;
+    faultWindow = faultAroundAdaptive ? 0 : faultAround;
+    expectedFault = 0;
+    numResident = lastFault = lastFaultTime = 0;
+    suspended = FALSE;
+    exiting = FALSE;
+    workingSet = 0;
+    resume = NULL;
+    procStats = stats->NewProcess();
+    switchedIn = stats->userTicks;
+
+// nothing is read in until it is touched; see PageIn.  Code pages are
+// shared with everyone else running the program.
+    pages = new Page *[numPages];
+    for (i = 0; i < numPages; i++)
+	if (IsReadOnly(i)) {
+	    pages[i] = exe->TextPage(i);
+	    pages[i]->refs++;
+	} else
+	    pages[i] = NULL;
+
+// with a TLB, misses are refilled from our own page table
+    if (machine->tlb != NULL) {
+	pageTable = new TranslationEntry[numPages];
+	for (i = 0; i < numPages; i++) {
+	    pageTable[i].virtualPage = i;
+	    pageTable[i].physicalPage = -1;
+	    pageTable[i].valid = FALSE;
+	    pageTable[i].use = FALSE;
+	    pageTable[i].dirty = FALSE;
+	    pageTable[i].readOnly = IsReadOnly(i);
+	    pageTable[i].tid = -1;
+	}
+    } else
+	pageTable = NULL;		// pages are mapped in machine->pageTable
 // first, set up the translation 
 	/*
 	if(numPages > NumPhysPages)
@@ -106,59 +409,145 @@ AddrSpace::AddrSpace(OpenFile *executable)
     }
 	*/
 	//printf("addr:%p\n",pageTable);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a copy of an address space for Fork, without copying any
+//	page.  Every page the parent has touched is shared, and the
+//	parent's mapping of it is made read-only, so that whichever of
+//	the two first writes to the page traps and gets its own copy
+//	(see ExceptionHandler).  Untouched pages other than code are not
+//	shared: each space will bring in its own from the executable.
+//
+//	"parent" -- the address space being forked
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent)
+{
+    unsigned int i;
+    Page *page;
+    TranslationEntry *entry;
 
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-    //bzero(machine->mainMemory, size);
-
-// then, copy in the code and data segments into memory
-	 
-	int diskPos = 0;
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-			noffH.code.virtualAddr, noffH.code.size);
-	int codePos = noffH.code.inFileAddr;
-	
-	for(int j = 0; j < noffH.code.size; j ++)
-	{
-		
-		//int tempvpn = (noffH.code.virtualAddr + j)/PageSize;
-		//int tempoff = (noffH.code.virtualAddr + j)%PageSize;
-		//int tempVaddr = pageTable[tempvpn].physicalPage*PageSize + tempoff;
-		executable->ReadAt(&(machine->mainMemory[0]), 1, codePos++);
-		machine->disk->WriteAt(&(machine->mainMemory[0]), 1, diskPos++);
+    exe = parent->exe;
+    exe->AddReference();
+    numPages = parent->numPages;
+    codeFirst = parent->codeFirst;
+    codeEnd = parent->codeEnd;
+    faultWindow = parent->faultWindow;
+    expectedFault = parent->expectedFault;
+    numResident = lastFault = lastFaultTime = 0;
+    suspended = FALSE;
+    exiting = FALSE;
+    workingSet = 0;
+    resume = NULL;
+    procStats = stats->NewProcess();
+    switchedIn = stats->userTicks;
+
+    pages = new Page *[numPages];
+    for (i = 0; i < numPages; i++) {
+	page = parent->pages[i];
+	pages[i] = page;
+	if (page == NULL)
+	    continue;
+	page->refs++;
+	if (page->frame >= 0 && coreMap[page->frame].space == parent) {
+	    entry = coreMap[page->frame].entry;
+	    entry->readOnly = TRUE;
+	    machine->InvalidateTranslation(entry->tid, i);
 	}
-	
-        //executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr]),
-			//noffH.code.size, noffH.code.inFileAddr);
     }
-	
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-			noffH.initData.virtualAddr, noffH.initData.size);
-		int dataPos = noffH.initData.inFileAddr;
-		for(int j = 0; j <noffH.initData.size; j ++)
-		{
-		
-		//int tempvpn = (noffH.initData.virtualAddr + j)/PageSize;
-		//int tempoff = (noffH.initData.virtualAddr + j)%PageSize;
-		//int tempVaddr = pageTable[tempvpn].physicalPage*PageSize + tempoff;
-		executable->ReadAt(&(machine->mainMemory[0]), 1, dataPos ++);
-        machine->disk->WriteAt(&(machine->mainMemory[0]), 1, diskPos++);
-    	}
-	}
-	
 
+    if (parent->pageTable != NULL) {
+	pageTable = new TranslationEntry[numPages];
+	for (i = 0; i < numPages; i++) {
+	    pageTable[i].virtualPage = i;
+	    pageTable[i].physicalPage = -1;
+	    pageTable[i].valid = FALSE;
+	    pageTable[i].use = FALSE;
+	    pageTable[i].dirty = FALSE;
+	    pageTable[i].readOnly = IsReadOnly(i);
+	    pageTable[i].tid = -1;
+	}
+    } else
+	pageTable = NULL;
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space.  Its mappings are removed, and the
+//	page frames and swap slots of pages nobody else shares are given
+//	back.  The thread running in it deletes it (see SC_Exit), so the
+//	time since it was switched to counts as its own.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+    Page *page;
+
+    SaveState();
+
+    for (unsigned int i = 0; i < numPages; i++) {
+	page = pages[i];
+	if (page == NULL)
+	    continue;
+	if (page->frame >= 0 && coreMap[page->frame].space == this)
+	    UnmapFrame(page->frame);
+	ReleasePage(page);
+    }
+    delete [] pages;
+    exe->Close();
+    delete [] pageTable;
+    delete resume;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Fill page frames with a run of virtual pages, on a page fault.  A
+//	page that has been written to swap is read back from there, in
+//	one read together with any following pages that lie in the next
+//	slots.  Otherwise the page has never been changed: the parts of it
+//	in the code or initialized data segments come from the executable,
+//	and the rest (uninitialized data and stack) is zero.
+//
+//	"vpn" -- the first virtual page
+//	"count" -- how many pages
+//	"frames" -- the page frame for each of them
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageIn(unsigned int vpn, int count, int *frames)
+{
+    int i, j, run, slot;
+    char *into, *buffer;
+
+    ASSERT(vpn + count <= numPages);
+    for (i = 0; i < count; i += run) {
+	into = &(machine->mainMemory[frames[i] * PageSize]);
+	slot = pages[vpn + i]->swapSlot;
+	run = 1;
+	if (slot < 0) {
+	    bzero(into, PageSize);
+	    ReadSegment(exe->file, &exe->noffH.code, vpn + i,
+			into);
+	    ReadSegment(exe->file, &exe->noffH.initData,
+			vpn + i, into);
+	    continue;
+	}
+	while ((i + run < count) && (pages[vpn + i + run]->swapSlot == slot + run))
+	    run++;
+	if (run == 1) {
+	    swapDisk->ReadPages(slot, 1, into);
+	    continue;
+	}
+	buffer = new char[run * PageSize];
+	swapDisk->ReadPages(slot, run, buffer);
+	for (j = 0; j < run; j++)
+	    bcopy(buffer + j * PageSize,
+		&(machine->mainMemory[frames[i + j] * PageSize]), PageSize);
+	delete [] buffer;
+	stats->numClusteredReads++;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -198,24 +587,45 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	Nothing!  TLB entries are tagged with the thread they belong to,
+//	so they can stay in the TLB while other threads run.  Only the
+//	time it ran is added up.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    procStats->userTicks += stats->userTicks - switchedIn;
+    switchedIn = stats->userTicks;
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//	Nothing, as for SaveState: the machine either looks our pages up
+//	by thread in the inverted page table, or misses in the TLB and
+//	lets the kernel refill it from our page table.  The time it runs
+//	from now on is its own.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
+    switchedIn = stats->userTicks;
+    if (procStats->tid < 0)
+	procStats->tid = currentThread->gettid();
     //machine->pageTable = pageTable;
     //machine->pageTableSize = numPages;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::VirtualTime
+// 	Return how long this address space has run user code: its own
+//	clock, which stops while other programs run.
+//----------------------------------------------------------------------
 
+int
+AddrSpace::VirtualTime()
+{
+    return procStats->userTicks + stats->userTicks - switchedIn;
+}
@@ -2,9 +2,16 @@
 //	Data structures to keep track of executing user programs 
 //	(address spaces).
 //
-//	For now, we don't keep any information about address spaces.
-//	The user level CPU state is saved and restored in the thread
-//	executing the user program (see thread.h).
+//	Pages are brought in on demand: an address space remembers where
+//	its segments are in the executable, and which of its pages have
+//	been written to the swap disk.  The user level CPU state is saved
+//	and restored in the thread executing the user program (see
+//	thread.h).
+//
+//	A forked address space shares its parent's pages copy-on-write:
+//	each page of a user program is a Page, with a count of the
+//	address spaces sharing it, and is mapped read-only while it is
+//	shared.  The first write to it makes a private copy.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -15,15 +22,75 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
+
+class Semaphore;
+class ProcessStats;
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// The contents of one virtual page, once it has been touched.  A page is
+// in a page frame, in swap, or both; one that is in neither has not
+// been changed since it came from the executable.
+
+class Page {
+  public:
+    Page();				// A page in neither place
+    ~Page();				// Give back its swap slot
+
+    int frame;				// Page frame holding it, or -1
+    int swapSlot;			// Its copy in swap, or -1
+    bool dirty;				// Changed since it was last saved,
+					// other than through the translation
+					// now mapping it
+    bool prefetched;			// Brought in by fault-around, and
+					// not known to have been used since
+    int refs;				// Address spaces sharing it, and
+					// the Executable for a code page
+};
+
+// An executable file, kept open while any address space started from it
+// (or forked from one that was) still needs to page code and data in.
+// Address spaces running the same file share one Executable, found by
+// the sector of the file's header, and with it the pages lying wholly
+// within the code segment; these are read-only, so one copy in memory
+// serves everyone.
+
+class Executable {
+  public:
+    static Executable *Open(OpenFile *file);
+					// Return the Executable for "file",
+					// which is closed if there already
+					// is one
+    void AddReference() { refs++; }	// Share it with one more space
+    void Close();			// Drop a reference
+
+    OpenFile *file;			// The object code
+    NoffHeader noffH;			// Where the segments are in it
+    unsigned int codeFirst, codeEnd;	// Pages lying wholly within the
+					// code segment
+    Page *TextPage(unsigned int vpn)	// The shared copy of a code page
+	{ return text[vpn - codeFirst]; }
+
+  private:
+    Executable(OpenFile *openFile);	// Read the NOFF header of "openFile"
+    ~Executable();			// Close the file
+
+    int sector;				// Header sector of the file
+    Page **text;			// The code pages
+    int refs;				// Address spaces using it
+    Executable *next;			// Next in the list of open ones
+};
+
 class AddrSpace {
   public:
-    AddrSpace(OpenFile *executable);	// Create an address space,
-					// initializing it with the program
-					// stored in the file "executable"
-    ~AddrSpace();			// De-allocate an address space
+    AddrSpace(OpenFile *executable);	// Create an address space for
+					// the program stored in the file
+					// "executable", which it keeps open
+    AddrSpace(AddrSpace *parent);	// Create a copy-on-write copy of
+					// the address space "parent"
+    ~AddrSpace();			// De-allocate an address space,
+					// and free its page frames
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
@@ -31,11 +98,79 @@ class AddrSpace {
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    bool IsReadOnly(unsigned int vpn)	// Does the page hold only code?
+	{ return (vpn >= codeFirst) && (vpn < codeEnd); }
+    bool IsValidPage(unsigned int vpn)	// Is the page part of the space?
+	{ return vpn < numPages; }
+    TranslationEntry *PageTableEntry(unsigned int vpn)
+	{ return &pageTable[vpn]; }	// Where the TLB is loaded from
+    Page *GetPage(unsigned int vpn)	// NULL if the page is untouched
+	{ return pages[vpn]; }
+    void SetPage(unsigned int vpn, Page *page)
+	{ pages[vpn] = page; }
+
+    void PageIn(unsigned int vpn, int count, int *frames);
+					// Fill page frames with the current
+					// contents of "count" virtual pages
+					// starting at "vpn"
+
+    int faultWindow;			// How many pages to bring in after
+					// a faulting one
+    unsigned int expectedFault;		// Where the next fault would be, if
+					// the program is running through
+					// its pages in order
+
+    int VirtualTime();			// How long it has run user code; it
+					// must be the one running
+    int numResident;			// Page frames it has mapped
+    int lastFault;			// Its VirtualTime at its last page
+    int lastFaultTime;			// fault, and the total time then
+    bool suspended;			// Swapped out to make room for
+					// others, until it is resumed
+    bool exiting;			// Its program has called Exit, so
+					// it is not worth swapping out
+    int workingSet;			// Page frames it had then
+    Semaphore *resume;			// Where it waits to be resumed; NULL
+					// if it never was suspended
+    ProcessStats *procStats;		// Its share of the statistics
+
   private:
-    TranslationEntry *pageTable;	// Assume linear page table translation
-					// for now!
+    TranslationEntry *pageTable;	// Linear page table, if the machine
+					// has a TLB; otherwise pages are
+					// mapped in machine->pageTable
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    unsigned int codeFirst, codeEnd;	// Pages lying wholly within the
+					// code segment, which are mapped
+					// read-only
+    Executable *exe;			// Where code and data pages come from
+    Page **pages;			// Contents of each virtual page
+    int switchedIn;			// stats->userTicks when it was last
+					// switched to
+};
+
+// The kernel's record of what is in each physical page frame.  A page
+// shared by several address spaces is mapped by only one of them at a
+// time; the others take a page fault and remap it.  "entry" is that
+// mapping: an entry of machine->pageTable, or, with a TLB, of the
+// mapping address space's page table.  A frame the page daemon has
+// freed keeps its page, unmapped, until the frame is reused, so that
+// a fault on the page in the meantime can take it back.
+
+class FrameInfo {
+  public:
+    Page *page;				// What is here; NULL if nothing
+    AddrSpace *space;			// Who has it mapped; NULL if no one
+    TranslationEntry *entry;		// The mapping
 };
 
+extern void UnmapFrame(int frame);	// Remove a frame's mapping
+extern void SavePage(Page *page, int near = -1);
+					// Write a page out to swap
+extern void SavePages(Page **pages, int *near, int count);
+					// Write several, in as few runs
+					// of slots as possible
+extern void ReleasePage(Page *page);	// Drop a reference to a page
+extern void StartPageDaemon();		// Keep frames free in the background
+
 #endif // ADDRSPACE_H
@@ -2,6 +2,12 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	Find and NumClear work a word at a time: a word with any clear
+//	bit is found by comparing it against all ones, the bit within it
+//	by counting trailing zeros of its complement, and the bits in use
+//	by counting the ones.  Find also remembers how far the map is
+//	known to be full, so that it need not start over from bit 0.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -22,8 +28,9 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    searchFrom = 0;
 }
 
 //----------------------------------------------------------------------
@@ -64,6 +71,8 @@ BitMap::Clear(int which)
       //  printf("which::%d num Bits:%d\n", which, numBits);
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (which < searchFrom)
+	searchFrom = which;
 }
 
 //----------------------------------------------------------------------
@@ -90,17 +99,26 @@ BitMap::Test(int which)
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
+//	The search starts at the word holding "searchFrom", since no
+//	earlier bit is clear, and skips every word that is all ones.
+//
 //	If no bits are clear, return -1.
 //----------------------------------------------------------------------
 
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    for (int w = searchFrom / BitsInWord; w < numWords; w++)
+	if (map[w] != ~0U) {
+	    int which = w * BitsInWord + __builtin_ctz(~map[w]);
+
+	    if (which >= numBits)
+		break;			// only the unused tail is clear
+	    Mark(which);
+	    searchFrom = which + 1;
+	    return which;
 	}
+    searchFrom = numBits;
     return -1;
 }
 
@@ -113,10 +131,16 @@ BitMap::Find()
 int 
 BitMap::NumClear() 
 {
-    int count = 0;
+    int count = numBits;
+    int tail = numBits % BitsInWord;	// bits used in the last word
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
+    for (int w = 0; w < numWords; w++) {
+	unsigned int word = map[w];
+
+	if ((w == numWords - 1) && (tail != 0))
+	    word &= (1U << tail) - 1;	// ignore the unused tail
+	count -= __builtin_popcount(word);
+    }
     return count;
 }
 
@@ -151,6 +175,7 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    searchFrom = 0;
 }
 
 //----------------------------------------------------------------------
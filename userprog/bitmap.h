@@ -3,7 +3,8 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Find
+//	and NumClear look at a whole word at a time.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -40,8 +41,8 @@ class BitMap {
     void Mark(int which);   	// Set the "nth" bit
     void Clear(int which);  	// Clear the "nth" bit
     bool Test(int which);   	// Is the "nth" bit set?
-    int Find();            	// Return the # of a clear bit, and as a side
-				// effect, set the bit. 
+    int Find();            	// Return the # of the first clear bit, and
+				// as a side effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear();		// Return the number of clear bits
 
@@ -59,6 +60,8 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int searchFrom;			// where Find starts looking: no
+					// bit before this one is clear
 };
 
 #endif // BITMAP_H
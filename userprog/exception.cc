@@ -4,8 +4,8 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  Right now, we support "Halt", "Exit",
+//	"Exec" and "Fork".
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,8 +14,9 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
-// Everything else core dumps.
+// Besides those system calls, this handles page faults, and writes to
+// read-only pages that are really copy-on-write.  Everything else core
+// dumps.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +25,22 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#include "synch.h"
+
+#define MaxExecNameLen	255	// longest program name Exec accepts
+
+static bool WriteFault();
+static void AdvancePC();
+static void EndProcess();
+static void ExecThread(int arg);
+static void ForkedThread(int func);
+static void LockPaging();
+static void UnlockPaging();
+static void WakePageDaemon(int frame);
+static void ResumeProcesses(bool exited);
+static void FrameFreed(int temp_i);
+
+static List *suspendedList = NULL;	// programs waiting to be resumed
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -56,12 +73,54 @@ ExceptionHandler(ExceptionType which)
     if ((which == SyscallException) && (type == SC_Halt)) {
 	DEBUG('a', "Shutdown, initiated by user program.\n");
    	interrupt->Halt();
+    }
+    else if ((which == SyscallException) && (type == SC_Exit)) {
+	printf("User program exited with status %d\n", machine->ReadRegister(4));
+	EndProcess();
+    }
+    else if ((which == SyscallException) && (type == SC_Fork)) {
+	Thread *child = new Thread("forked");
+
+	child->space = new AddrSpace(currentThread->space);
+	child->SaveUserState();		// the child starts with our registers
+	child->Fork(ForkedThread, (void *) machine->ReadRegister(4));
+	AdvancePC();
+    }
+    else if ((which == SyscallException) && (type == SC_Exec)) {
+	char name[MaxExecNameLen + 1];
+	int addr = machine->ReadRegister(4);
+	int i, c;
+	OpenFile *executable;
+	Thread *thread;
+
+	for (i = 0; i <= MaxExecNameLen; i++) {
+	    while (!machine->ReadMem(addr + i, 1, &c))
+		;			// the page fault brought it in
+	    name[i] = (char) c;
+	    if (c == '\0')
+		break;
+	}
+	name[MaxExecNameLen] = '\0';
+	executable = fileSystem->Open(name);
+	if (executable == NULL) {
+	    printf("Unable to open file %s\n", name);
+	    machine->WriteRegister(2, -1);
+	} else {
+	    thread = new Thread("exec");
+	    thread->space = new AddrSpace(executable);
+	    thread->Fork(ExecThread, 0);
+	    machine->WriteRegister(2, thread->gettid());
+	}
+	AdvancePC();
     }
 	else if((which == PageFaultException))
 	{
-		
 		machine->LRU();
 	}
+	else if((which == ReadOnlyException) && WriteFault())
+	{
+		// the write is tried again, and now succeeds
+	}
 	
     else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
@@ -69,52 +128,860 @@ ExceptionHandler(ExceptionType which)
     }
 }
 
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Step the user program past the system call it just made.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+	machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+	machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+	machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg) + 4);
+}
+
+//----------------------------------------------------------------------
+// EndProcess
+// 	The user program is done, by calling Exit or by being killed:
+//	give back its address space -- and with it the pages, frames and
+//	swap slots no one else shares -- and finish the thread.  A space
+//	SuspendProcess swapped out, and that was not resumed yet, comes off
+//	the suspended list first, so ResumeProcesses never sees it freed.
+//----------------------------------------------------------------------
+
+static void
+EndProcess()
+{
+	AddrSpace *space = currentThread->space;
+
+	currentThread->space = NULL;
+	space->exiting = TRUE;
+	LockPaging();
+	if(space->suspended)
+		suspendedList->Remove((void *) space);
+	delete space;
+	ResumeProcesses(TRUE);
+	UnlockPaging();
+	currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// ExecThread
+// 	Start running a program loaded by Exec, as StartProcess does for
+//	the first one.
+//----------------------------------------------------------------------
+
+static void
+ExecThread(int arg)
+{
+	currentThread->space->InitRegisters();
+	currentThread->space->RestoreState();
+	machine->Run();
+	ASSERT(FALSE);			// machine->Run never returns
+}
+
+//----------------------------------------------------------------------
+// ForkedThread
+// 	Run the child of a Fork.  It starts with the registers its parent
+//	had at the system call, in a copy of its parent's address space,
+//	but at the function the parent passed to Fork.
+//
+//	"func" -- the user address of the function
+//----------------------------------------------------------------------
+
+static void
+ForkedThread(int func)
+{
+	currentThread->RestoreUserState();
+	currentThread->space->RestoreState();
+	machine->WriteRegister(PCReg, func);
+	machine->WriteRegister(NextPCReg, func + 4);
+	machine->Run();
+	ASSERT(FALSE);			// machine->Run never returns
+}
+
+//----------------------------------------------------------------------
+// LoadTLB
+// 	Put a translation from an address space's page table into the TLB.
+//	It goes in the set for its virtual page, in an empty entry if
+//	there is one, and otherwise in place of the entry chosen by
+//	"tlbReplacement": the one whose page was used least recently, the
+//	one loaded longest ago, or one at random.
+//
+//	A page that is still clean goes in read-only, so that the first
+//	write to it traps to WriteFault and the page table learns that the
+//	page has to be written back if it is evicted.
+//
+//	"entry" -- the translation; the page must be in memory
+//----------------------------------------------------------------------
+
+static int *fifoNext = NULL;	// for each TLB set, the way loaded longest ago
+
+static void
+LoadTLB(TranslationEntry *entry)
+{
+	TranslationEntry *tlb = machine->tlb;
+	int set = TLBSetOf((unsigned) entry->virtualPage);
+	int first = set * TLBWays;
+	int slot = -1;
+
+	if(fifoNext == NULL)
+	{
+		fifoNext = new int[TLBSize / TLBWays];
+		for(int i = 0; i < TLBSize / TLBWays; i ++)
+			fifoNext[i] = 0;
+	}
+	for(int i = first; i < first + TLBWays; i ++)
+		if(!tlb[i].valid)
+		{
+			slot = i;
+			break;
+		}
+	if(slot < 0)
+	{
+		switch(tlbReplacement)
+		{
+		  case TLBReplaceLRU:
+			slot = first;
+			for(int i = first + 1; i < first + TLBWays; i ++)
+				if(machine->pageLasttime[tlb[i].physicalPage] < machine->pageLasttime[tlb[slot].physicalPage])
+					slot = i;
+			break;
+		  case TLBReplaceFIFO:
+			slot = first + fifoNext[set];
+			fifoNext[set] = (fifoNext[set] + 1) % TLBWays;
+			break;
+		  case TLBReplaceRandom:
+			slot = first + Random() % TLBWays;
+			break;
+		}
+		machine->InvalidateTranslation(tlb[slot].tid, tlb[slot].virtualPage);
+	}
+	tlb[slot] = *entry;
+	tlb[slot].readOnly = entry->readOnly || !entry->dirty;
+	entry->use = TRUE;
+}
+
+//----------------------------------------------------------------------
+// MapFrame
+// 	Map a page frame at a virtual page of an address space, replacing
+//	the frame's old mapping, if any, which the caller has removed.
+//	The page is mapped read-only if it is code, or if it is shared,
+//	so that writing it makes a copy.
+//
+//	"frame" -- the page frame; coreMap[frame].page is already set
+//	"space", "vpn" -- where to map it
+//----------------------------------------------------------------------
+
+static TranslationEntry *
+MapFrame(int frame, AddrSpace *space, unsigned int vpn)
+{
+	TranslationEntry *entry;
+
+	if(machine->tlb != NULL)
+		entry = space->PageTableEntry(vpn);
+	else
+		entry = &(machine->pageTable[frame]);
+	entry->physicalPage = frame;
+	entry->tid = currentThread->gettid();
+	entry->virtualPage = vpn;
+	entry->valid = TRUE;
+	if(machine->invertedPageTable != NULL)
+		machine->invertedPageTable->Insert(entry);
+	coreMap[frame].space = space;
+	coreMap[frame].entry = entry;
+	if(++space->numResident > space->procStats->peakResident)
+		space->procStats->peakResident = space->numResident;
+	entry->readOnly = space->IsReadOnly(vpn) || (coreMap[frame].page->refs > 1);
+	entry->dirty = FALSE;	// the page remembers earlier writes
+	return entry;
+}
+
+//----------------------------------------------------------------------
+// UnmapVictim
+// 	Unmap the page in a frame that is being taken from it, and return
+//	whether it was modified since it was last saved, and so has to be
+//	written back before the frame can be reused.  A page that is
+//	written out for the first time should go after the page before
+//	it, if there is room, so that fault-around can read both at once;
+//	"near" is set to that slot, or -1.  Throwing out a page that
+//	fault-around brought in for nothing counts against it.
+//
+//	"temp_i" -- the page frame
+//	"near" -- where to put the slot the page should be written to
+//----------------------------------------------------------------------
+
+static bool
+UnmapVictim(int temp_i, int *near)
+{
+	Page *victim = coreMap[temp_i].page;
+	TranslationEntry *entry = coreMap[temp_i].entry;
+	AddrSpace *space = coreMap[temp_i].space;
+	Page *before;
+
+	*near = -1;
+	if(entry != NULL)
+	{
+		printf("virtual page %d is writen back to the disk and physical page %d is free\n", entry->virtualPage, temp_i);
+		if(entry->virtualPage > 0)
+		{
+			before = space->GetPage(entry->virtualPage - 1);
+			if((before != NULL) && (before->swapSlot >= 0))
+				*near = before->swapSlot + 1;
+		}
+	}
+	if(victim->prefetched && ((entry == NULL) || !entry->use))
+	{
+		stats->numPrefetchesUnused++;
+		if(faultAroundAdaptive && (space != NULL))
+			space->faultWindow /= 2;	// a wrong guess
+	}
+	victim->prefetched = FALSE;
+	UnmapFrame(temp_i);
+	if(victim->dirty)
+		return TRUE;
+	stats->numCleanEvictions++;
+	return FALSE;
+}
+
+//----------------------------------------------------------------------
+// CleanFrame
+// 	Unmap the page in a frame, and write it back to the swap disk
+//	only if it was modified since it was last saved, so that the frame
+//	can be reused.
+//
+//	"temp_i" -- the page frame
+//----------------------------------------------------------------------
+
+static void
+CleanFrame(int temp_i)
+{
+	int near;
+
+	if(UnmapVictim(temp_i, &near))
+	{
+		SavePage(coreMap[temp_i].page, near);
+		stats->numDirtyEvictions++;
+	}
+}
+
+//----------------------------------------------------------------------
+// EvictFrame
+// 	Throw out the page in a frame, so that another can be brought in.
+//
+//	"temp_i" -- the page frame
+//----------------------------------------------------------------------
+
+static void
+EvictFrame(int temp_i)
+{
+	CleanFrame(temp_i);
+	coreMap[temp_i].page->frame = -1;
+	coreMap[temp_i].page = NULL;
+}
+
+//----------------------------------------------------------------------
+// FreeFrame
+// 	Give back a page frame whose page is still wanted, but not enough
+//	to keep it from others.  The page is unmapped and written back,
+//	but left in the frame until the frame is reused, so that a fault
+//	on it in the meantime can take it back.
+//
+//	"temp_i" -- the page frame
+//----------------------------------------------------------------------
+
+static int *timeFreed = NULL;	// when each frame was freed
+static int framesFreed = 0;	// the clock for that
+
+static void
+FreeFrame(int temp_i)
+{
+	CleanFrame(temp_i);
+	FrameFreed(temp_i);
+}
+
+//----------------------------------------------------------------------
+// FrameFreed
+// 	Mark a frame, whose page has been unmapped and saved, as free.
+//
+//	"temp_i" -- the page frame
+//----------------------------------------------------------------------
+
+static void
+FrameFreed(int temp_i)
+{
+	if(timeFreed == NULL)
+		timeFreed = new int[NumPhysPages];
+	memBitMap->Clear(temp_i);
+	timeFreed[temp_i] = framesFreed++;
+}
+
+//----------------------------------------------------------------------
+// TakeFreeFrame
+// 	Allocate a free page frame, if there is one, and return it, or -1.
+//	An empty frame is taken first; otherwise the one freed longest ago
+//	(see FreeFrame), whose page was thought the least likely to be
+//	used again.  Its page is then no longer in memory.
+//----------------------------------------------------------------------
+
+static int
+TakeFreeFrame()
+{
+	int temp_i = memBitMap->Find();
+
+	if((temp_i < 0) || (coreMap[temp_i].page == NULL))
+		return temp_i;
+	memBitMap->Clear(temp_i);
+	for(int i = 0; i < NumPhysPages; i ++)
+		if(!memBitMap->Test(i) && (coreMap[i].page == NULL))
+		{
+			temp_i = i;
+			break;
+		}
+		else if(!memBitMap->Test(i) && (timeFreed[i] < timeFreed[temp_i]))
+			temp_i = i;
+	memBitMap->Mark(temp_i);
+	if(coreMap[temp_i].page != NULL)
+	{
+		coreMap[temp_i].page->frame = -1;
+		coreMap[temp_i].page = NULL;
+	}
+	return temp_i;
+}
+
+//----------------------------------------------------------------------
+// TrimResidentSet
+// 	Free the page frames of an address space whose pages it has not
+//	used since its last page fault.  With -ws, a program that faults
+//	seldom gives these back, keeping only the pages it is working in.
+//
+//	"space" -- the address space
+//----------------------------------------------------------------------
+
+static void
+TrimResidentSet(AddrSpace *space)
+{
+	for(int i = 0; i < NumPhysPages; i ++)
+		if((coreMap[i].space == space)
+				&& (machine->pageLasttime[i] < space->lastFaultTime))
+		{
+			FreeFrame(i);
+			stats->numPagesTrimmed++;
+		}
+}
+
+//----------------------------------------------------------------------
+// SuspendProcess
+// 	Make room for an address space that needs more page frames, when
+//	there are none free, by swapping out another program: the one
+//	with the most frames.  Its frames are freed, and it waits, at its
+//	next page fault, until ResumeProcesses lets it go on.  Returns
+//	FALSE if no other program has any frames.
+//
+//	"space" -- the address space needing the room
+//----------------------------------------------------------------------
+
+static bool
+SuspendProcess(AddrSpace *space)
+{
+	AddrSpace *victim = NULL;
+
+	for(int i = 0; i < NumPhysPages; i ++)
+		if((coreMap[i].space != NULL) && (coreMap[i].space != space)
+				&& !coreMap[i].space->suspended
+				&& !coreMap[i].space->exiting
+				&& ((victim == NULL) || (coreMap[i].space->numResident > victim->numResident)))
+			victim = coreMap[i].space;
+	if(victim == NULL)
+		return FALSE;
+	DEBUG('a', "a program with %d page frames is suspended\n", victim->numResident);
+	victim->workingSet = victim->numResident;
+	for(int i = 0; i < NumPhysPages; i ++)
+		if(coreMap[i].space == victim)
+			FreeFrame(i);
+	victim->suspended = TRUE;
+	if(victim->resume == NULL)
+		victim->resume = new Semaphore("resume", 0);
+	if(suspendedList == NULL)
+		suspendedList = new List();
+	suspendedList->Append((void *) victim);
+	victim->procStats->numSuspensions++;
+	stats->numSuspensions++;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ResumeProcesses
+// 	Let suspended programs go on, in the order they were suspended,
+//	while there are as many free page frames as each had.  A program
+//	that exits always makes room for one, even if it had fewer, so
+//	that they are not left waiting for one another.
+//
+//	"exited" -- TRUE if a program has just exited
+//----------------------------------------------------------------------
+
+static void
+ResumeProcesses(bool exited)
+{
+	AddrSpace *space;
+
+	while((suspendedList != NULL) && !suspendedList->IsEmpty())
+	{
+		space = (AddrSpace *) suspendedList->FirstItem()->item;
+		if(!exited && (memBitMap->NumClear() < space->workingSet))
+			break;
+		suspendedList->Remove();
+		space->suspended = FALSE;
+		space->resume->V();
+		exited = FALSE;
+	}
+}
+
+//----------------------------------------------------------------------
+// AdjustResidentSet
+// 	Page fault frequency control of the frames an address space has,
+//	on a page fault, with -ws.  If the program has run for more than
+//	"pffInterval" ticks of its own time since its last page fault, it
+//	needs fewer frames than it has: the pages it has not used since
+//	are taken away.  Otherwise it needs more.
+//
+//	"space" -- the faulting address space
+//
+//	Returns TRUE if it should get another frame, rather than
+//	replacing one of its own pages.
+//----------------------------------------------------------------------
+
+static bool
+AdjustResidentSet(AddrSpace *space)
+{
+	int now = space->VirtualTime();
+	bool grow = (now - space->lastFault <= pffInterval);
+
+	if(!grow)
+	{
+		TrimResidentSet(space);
+		ResumeProcesses(FALSE);
+	}
+	space->lastFault = now;
+	space->lastFaultTime = stats->totalTicks;
+	return grow;
+}
+
+//----------------------------------------------------------------------
+// FindFrame
+// 	Return a page frame to bring a page into.  A free page frame is
+//	used if there is one; otherwise the replacement policy picks a page
+//	to throw out.
+//
+//	With -ws, an address space that should grow suspends another
+//	program to make room, if it can; otherwise the page thrown out is
+//	one of its own, if it has any.
+//
+//	"space" -- the address space the page is for
+//	"grow" -- should it get another frame?  (see AdjustResidentSet)
+//----------------------------------------------------------------------
+
+static int
+FindFrame(AddrSpace *space, bool grow)
+{
+	int temp_i = TakeFreeFrame();
+
+	if((temp_i < 0) && (pffInterval > 0) && grow && SuspendProcess(space))
+		temp_i = TakeFreeFrame();
+	//all the physical page have been used
+	if(temp_i < 0)
+	{
+		printf("all the physical pages have been used\n");
+		stats->numFaultEvictions++;
+		if((pffInterval > 0) && (space->numResident > 0))
+			temp_i = replacementPolicy->SelectVictim(space);
+		else
+			temp_i = replacementPolicy->SelectVictim();
+		EvictFrame(temp_i);
+	}
+	return temp_i;
+}
+
+//----------------------------------------------------------------------
+// CopyOnWrite
+// 	Give an address space its own copy of a page it shares, because it
+//	is writing to it.  The contents are saved before a frame is found
+//	for the copy, since the shared page itself may be thrown out to
+//	make room.
+//
+//	"space", "vpn" -- the writer, and the page; it must be mapped
+//----------------------------------------------------------------------
+
+static void
+CopyOnWrite(AddrSpace *space, unsigned int vpn)
+{
+	Page *shared = space->GetPage(vpn);
+	Page *copy = new Page();
+	char *buffer = new char[PageSize];
+	TranslationEntry *entry;
+	int temp_i;
+
+	bcopy(&(machine->mainMemory[shared->frame * PageSize]), buffer, PageSize);
+	UnmapFrame(shared->frame);
+	ReleasePage(shared);
+
+	temp_i = FindFrame(space, FALSE);
+	copy->frame = temp_i;
+	copy->dirty = TRUE;		// there is no other copy of it
+	coreMap[temp_i].page = copy;
+	space->SetPage(vpn, copy);
+	entry = MapFrame(temp_i, space, vpn);
+	machine->InvalidateDecodedPage(temp_i);
+	bcopy(buffer, &(machine->mainMemory[temp_i * PageSize]), PageSize);
+	delete [] buffer;
+	stats->numCopyOnWrites++;
+	if(machine->tlb != NULL)
+	{
+		entry->dirty = TRUE;
+		LoadTLB(entry);
+	}
+}
+
+//----------------------------------------------------------------------
+// WriteFault
+// 	Handle a write through a read-only translation to a page that is
+//	not code.  Either the page is shared, and the writer gets a copy of
+//	its own, or it was mapped read-only only because it was shared and
+//	no longer is, or, with a TLB, it was loaded into the TLB read-only
+//	because it was clean (see LoadTLB).  Returns FALSE if the page
+//	really is read-only, which is an error in the user program.
+//----------------------------------------------------------------------
+
+static bool
+WriteFault()
+{
+	unsigned int vpn = (unsigned) machine->ReadRegister(BadVAddrReg) / PageSize;
+	AddrSpace *space = currentThread->space;
+	Page *page;
+	TranslationEntry *entry;
+	int tid = currentThread->gettid();
+
+	if(!space->IsValidPage(vpn) || space->IsReadOnly(vpn))
+		return FALSE;
+	page = space->GetPage(vpn);
+	ASSERT((page != NULL) && (page->frame >= 0) && (coreMap[page->frame].space == space));
+	if(page->refs > 1)
+	{
+		LockPaging();
+		if((page->frame >= 0) && (coreMap[page->frame].space == space))
+			CopyOnWrite(space, vpn);	// else thrown out while we waited
+		UnlockPaging();
+		WakePageDaemon(space->GetPage(vpn)->frame);
+		return TRUE;
+	}
+	entry = coreMap[page->frame].entry;
+	entry->readOnly = FALSE;
+	if(machine->tlb == NULL)
+	{
+		machine->InvalidateTranslation(tid, vpn);	// cached read-only
+		return TRUE;
+	}
+	entry->dirty = TRUE;
+	int first = TLBSetOf(vpn) * TLBWays;
+	for(int i = first; i < first + TLBWays; i ++)
+		if(machine->tlb[i].valid && (machine->tlb[i].tid == tid) && ((unsigned) machine->tlb[i].virtualPage == vpn))
+			machine->tlb[i].readOnly = FALSE;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FaultAround
+// 	Pick frames for the pages following a faulting one, so that they
+//	are brought in with it.  This stops at the end of the address
+//	space, at a page that is already in memory, after "faultWindow"
+//	pages, or when there is neither a free frame nor one whose page
+//	is cold: not referenced since the page fault before this one.  A
+//	page brought in but not used is cold by the next fault, so that
+//	wrong guesses are thrown out first; with an adaptive window, each
+//	one halves the window when it is thrown out (see EvictFrame).
+//
+//	"space", "vpn" -- the faulting page
+//	"since" -- the time of the page fault before this one
+//	"frames" -- frames[0] is the faulting page's frame; the ones
+//		chosen are put after it
+//
+//	Returns how many pages were added.
+//----------------------------------------------------------------------
+
+static int
+FaultAround(AddrSpace *space, unsigned int vpn, int since, int *frames)
+{
+	int count = 0, temp_i, i;
+	unsigned int next;
+	Page *page;
+	TranslationEntry *entry;
+
+	machine->pageLasttime[frames[0]] = stats->totalTicks;	// in use now
+	for(next = vpn + 1; (count < space->faultWindow) && space->IsValidPage(next); next ++)
+	{
+		page = space->GetPage(next);
+		if((page != NULL) && (page->frame >= 0))
+			break;
+		temp_i = TakeFreeFrame();
+		if(temp_i < 0)
+		{
+			temp_i = replacementPolicy->ColdVictim(since);
+			for(i = 0; (temp_i >= 0) && (i <= count); i ++)
+				if(frames[i] == temp_i)
+					temp_i = -1;		// one we are filling
+			if(temp_i < 0)
+				break;
+			EvictFrame(temp_i);
+		}
+		if(page == NULL)
+		{
+			page = new Page();
+			space->SetPage(next, page);
+		}
+		page->frame = temp_i;
+		coreMap[temp_i].page = page;
+		entry = MapFrame(temp_i, space, next);
+		entry->use = FALSE;
+		page->prefetched = TRUE;
+		machine->pageLasttime[temp_i] = since;
+		frames[++count] = temp_i;
+	}
+	stats->numPagesPrefetched += count;
+	return count;
+}
+
+//----------------------------------------------------------------------
+// Machine::LRU
+// 	Handle a page fault.  With a TLB this may only be a TLB miss, for
+//	a page that is in memory; then the TLB is just refilled.  A page
+//	shared with another address space may also be in memory but
+//	mapped by the other one, or be in a frame the page daemon freed
+//	but has not reused; then it is just remapped.
+//
+//	Otherwise the page is brought into memory, into a frame found by
+//	FindFrame, along with the pages FaultAround picks.  The address
+//	space knows where to find their contents.
+//
+//	With an adaptive window, a fault just past the pages brought in
+//	by the last one doubles the window, up to "faultAround", and any
+//	other fault halves it.
+//
+//	With -ws, a program that has been suspended to make room for
+//	others waits here to be resumed, and the fault frequency decides
+//	whether the program gets another frame (see AdjustResidentSet).
+//
+//	Taking a frame may leave too few free; then the page daemon is
+//	woken up, and allowed to run before the faulting instruction is
+//	tried again.
+//----------------------------------------------------------------------
+
+static int lastFaultTime = 0;	// when the last page was brought in
+static int *faultFrames = NULL;	// frames being filled, for FaultAround
+
 void Machine::LRU()
 {
 		
 		int virtAddr = machine->registers[BadVAddrReg];
 		unsigned int vpn = (unsigned) virtAddr / PageSize;
-		bool noPageLeft = TRUE;
-		int temp_i = 0;
-		//if there is page table not been used
-		for(int i = 0; i < NumPhysPages; i ++)
+		AddrSpace *space = currentThread->space;
+		TranslationEntry *entry;
+		Page *page;
+		int temp_i, since, count;
+		bool grow = TRUE;
+		if(!space->IsValidPage(vpn))
 		{
-			if((machine->pageTable[i]).use == FALSE)
+			DEBUG('a', "address 0x%x is outside the address space\n", virtAddr);
+			EndProcess();		// never returns
+		}
+		if(machine->tlb != NULL)
+		{
+			stats->totalTicks += tlbMissTicks;	// the refill below
+			stats->systemTicks += tlbMissTicks;
+			if(space->PageTableEntry(vpn)->valid)
 			{
-				(machine->pageTable[i]).physicalPage = memBitMap->Find();
-				//printf("physic :%d\n",(machine->pageTable[i]).physicalPage); 
-				(machine->pageTable[i]).tid = currentThread->gettid();
-				(machine->pageTable[i]).virtualPage = vpn;
-				(machine->pageTable[i]).valid = TRUE;
-				noPageLeft = FALSE;
-				temp_i = i;
-				break;
+				LoadTLB(space->PageTableEntry(vpn));
+				return;
 			}
 		}
-
-		//all the physical page have been used
-		if(noPageLeft == TRUE)
+		while(space->suspended)
+			space->resume->P();	// swapped out; see SuspendProcess
+		LockPaging();
+		page = space->GetPage(vpn);
+		if((page != NULL) && (page->frame >= 0))
 		{
-			printf("all the physical pages have been used\n");
-			int temp = 2147483644;	
-
-			for(int i = 0; i < NumPhysPages; i ++)
+			if(!memBitMap->Test(page->frame))
 			{
-				if(machine->pageLasttime[i] < temp)
-				{
-					temp = machine->pageLasttime[i];
-					temp_i = i;
-				}
+				memBitMap->Mark(page->frame);	// reclaimed
+				stats->numFramesReclaimed++;
 			}
-			//(machine->pageTable[temp_i]).physicalPage = temp_i;
-			printf("virtual page %d is writen back to the disk and physical page %d is free\n", (machine->pageTable[temp_i]).virtualPage, (machine->pageTable[temp_i]).physicalPage);
-			machine->disk->WriteAt(&(machine->mainMemory[(machine->pageTable[temp_i]).physicalPage*PageSize]), 128, (machine->pageTable[temp_i]).virtualPage*PageSize);
-			(machine->pageTable[temp_i]).tid = currentThread->gettid();
-			(machine->pageTable[temp_i]).virtualPage = vpn;
-			(machine->pageTable[temp_i]).valid = TRUE;
+			UnmapFrame(page->frame);
+			entry = MapFrame(page->frame, space, vpn);
+			if(machine->tlb != NULL)
+				LoadTLB(entry);
+			UnlockPaging();
+			WakePageDaemon(page->frame);
+			return;
 		}
+		stats->numPageFaults++;
+		space->procStats->numPageFaults++;
+		since = lastFaultTime;
+		lastFaultTime = stats->totalTicks;
+
+		if(pffInterval > 0)
+			grow = AdjustResidentSet(space);
+		temp_i = FindFrame(space, grow);
+		if(page == NULL)
+		{
+			page = new Page();
+			space->SetPage(vpn, page);
+		}
+		page->frame = temp_i;
+		coreMap[temp_i].page = page;
+
+		// map the page into the frame
+		entry = MapFrame(temp_i, space, vpn);
+		printf("physical page %d is distributed to virtual page %d\n", temp_i, vpn);
 
-		printf("physical page %d is distributed to virtual page %d\n", (machine->pageTable[temp_i]).physicalPage, vpn);
-		machine->disk->ReadAt(&(machine->mainMemory[(machine->pageTable[temp_i]).physicalPage*PageSize]), 128, vpn*PageSize);
+		if(faultFrames == NULL)
+			faultFrames = new int[faultAround + 1];
+		faultFrames[0] = temp_i;
+		count = 1;
+		if(faultAround > 0)
+		{
+			if(faultAroundAdaptive && ((vpn == space->expectedFault)
+					|| ((vpn > 0) && (space->GetPage(vpn - 1) != NULL)
+						&& (space->GetPage(vpn - 1)->frame >= 0))))
+				space->faultWindow = min(max(2 * space->faultWindow, 1), faultAround);
+			else if(faultAroundAdaptive)
+				space->faultWindow /= 2;
+			count += FaultAround(space, vpn, since, faultFrames);
+			space->expectedFault = vpn + count;
+		}
+		for(int i = 0; i < count; i ++)
+			machine->InvalidateDecodedPage(faultFrames[i]);
+		space->PageIn(vpn, count, faultFrames);
+		if(machine->tlb != NULL)
+			LoadTLB(entry);
+		UnlockPaging();
+		WakePageDaemon(temp_i);
 		//machine->diskPos += 128;
 }
+
+//----------------------------------------------------------------------
+// LockPaging, UnlockPaging
+// 	Reading or writing the swap disk, or with the real file system
+//	an executable, puts the thread to sleep, and the page daemon or
+//	another thread's page fault could change the page frames under
+//	it; page faults, the page daemon, and deleting an address space,
+//	take turns.
+//----------------------------------------------------------------------
+
+static Lock *pagingLock = NULL;
+
+static void
+LockPaging()
+{
+	if(pagingLock == NULL)
+		pagingLock = new Lock("paging");
+	pagingLock->Acquire();
+}
+
+static void
+UnlockPaging()
+{
+	pagingLock->Release();
+}
+
+//----------------------------------------------------------------------
+// PageDaemon
+// 	Keep page frames free, so that a page fault seldom has to throw
+//	out a page, and wait for it to be written back, before it can
+//	bring its own in.  Whenever fewer than "freeFramesLow" frames are
+//	free, the daemon is woken up, and frees frames, picked by the
+//	replacement policy, until "freeFramesHigh" are.
+//
+//	A freed frame keeps its page, written back if it was modified, but
+//	not mapped; a fault on the page before the frame is reused takes
+//	it back without reading it in.
+//
+//	The victims are picked, unmapped and marked free first, and then
+//	the modified ones are written back together, in runs of
+//	consecutive swap slots (see SavePages).  Faults wait for the
+//	paging lock meanwhile, so no frame is reused, or its page taken
+//	back, before the page is saved.
+//----------------------------------------------------------------------
+
+static Semaphore *daemonWakeup = NULL;
+static bool daemonAwake = FALSE;	// woken up but not done yet?
+
+static void
+PageDaemon(int arg)
+{
+	Page **dirty = new Page *[NumPhysPages];
+	int *near = new int[NumPhysPages];
+	int temp_i, numDirty;
+
+	for(;;)
+	{
+		daemonWakeup->P();
+		LockPaging();
+		numDirty = 0;
+		while(memBitMap->NumClear() < freeFramesHigh)
+		{
+			temp_i = replacementPolicy->SelectVictim();
+			if(UnmapVictim(temp_i, &near[numDirty]))
+				dirty[numDirty++] = coreMap[temp_i].page;
+			FrameFreed(temp_i);
+			stats->numFramesFreed++;
+		}
+		if(numDirty > 0)
+		{
+			SavePages(dirty, near, numDirty);
+			stats->numDirtyEvictions += numDirty;
+		}
+		daemonAwake = FALSE;
+		UnlockPaging();
+	}
+}
+
+//----------------------------------------------------------------------
+// StartPageDaemon
+// 	Fork the page daemon.  Called once at startup, if there is to be
+//	one.
+//----------------------------------------------------------------------
+
+void
+StartPageDaemon()
+{
+	Thread *daemon = new Thread("page daemon");
+
+	daemonWakeup = new Semaphore("page daemon", 0);
+	daemon->Fork(PageDaemon, 0);
+}
+
+//----------------------------------------------------------------------
+// WakePageDaemon
+// 	Wake the page daemon up if too few page frames are free, and give
+//	it the CPU.  The faulting instruction has not yet been tried again,
+//	so the page it needs is marked used, or the daemon would take it.
+//
+//	"frame" -- the page frame the faulting thread is about to use, or
+//		-1
+//----------------------------------------------------------------------
+
+static void
+WakePageDaemon(int frame)
+{
+	if((daemonWakeup == NULL) || daemonAwake
+			|| (memBitMap->NumClear() >= freeFramesLow))
+		return;
+	if((frame >= 0) && (coreMap[frame].entry != NULL))
+	{
+		coreMap[frame].entry->use = TRUE;
+		machine->pageLasttime[frame] = stats->totalTicks;
+	}
+	daemonAwake = TRUE;
+	daemonWakeup->V();
+	currentThread->Yield();
+}
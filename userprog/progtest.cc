@@ -13,6 +13,7 @@
 #include "console.h"
 #include "addrspace.h"
 #include "synch.h"
+#include <time.h>
 
 //----------------------------------------------------------------------
 // StartProcess
@@ -42,9 +43,8 @@ StartProcess(char *filename)
 	//space1 = new AddrSpace(executable1);
 	
    
-    currentThread->space = space;
+    currentThread->space = space;	// the space keeps the file open
 	//thread->space = space1;
-    delete executable;			// close file
 	//delete executable1;
 
     space->InitRegisters();		// set the initial register values
@@ -96,3 +96,213 @@ ConsoleTest (char *in, char *out)
 	if (ch == 'q') return;  // if q, quit
     }
 }
+
+//----------------------------------------------------------------------
+// LoadTest
+// 	Measure how long it takes to start a user program: opening the
+//	executable and building its address space.  Prints the host time,
+//	simulated time and disk traffic of one load, averaged over several.
+//----------------------------------------------------------------------
+
+void
+LoadTest(char *filename)
+{
+    const int loads = 20;
+    int ticks = stats->totalTicks;
+    int reads = stats->numDiskReads;
+    int writes = stats->numDiskWrites;
+    clock_t start = clock();
+    OpenFile *executable;
+    AddrSpace *space;
+
+    for (int i = 0; i < loads; i++) {
+	executable = fileSystem->Open(filename);
+	if (executable == NULL) {
+	    printf("Unable to open file %s\n", filename);
+	    return;
+	}
+	space = new AddrSpace(executable);
+	delete space;			// closes the executable too
+    }
+    printf("%s: %.1f us, %d ticks, disk reads %d, writes %d per load\n",
+	filename, (double) (clock() - start) / CLOCKS_PER_SEC * 1e6 / loads,
+	(stats->totalTicks - ticks) / loads,
+	(stats->numDiskReads - reads) / loads,
+	(stats->numDiskWrites - writes) / loads);
+}
+
+//----------------------------------------------------------------------
+// LinearLookup
+// 	Find a translation the way Translate used to: by comparing every
+//	entry of the inverted page table.
+//----------------------------------------------------------------------
+
+static TranslationEntry *
+LinearLookup(TranslationEntry *table, int numEntries, int tid, int vpn)
+{
+    TranslationEntry *entry = NULL;
+
+    for (int i = 0; i < numEntries; i++)
+	if ((table[i].tid == tid) && table[i].valid
+			&& (table[i].virtualPage == vpn))
+	    entry = &table[i];
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// PageTableTest
+// 	Measure how long a translation lookup takes in an inverted page
+//	table of 32, 1K and 64K physical pages, with the hash index and
+//	with a linear scan.  Every physical page is mapped, to one of 8
+//	threads, and we look up mapped pages at random.
+//----------------------------------------------------------------------
+
+void
+PageTableTest()
+{
+    static int sizes[] = { 32, 1024, 65536 };
+    const int work = 1 << 24;		// entries the linear scan compares
+    TranslationEntry *table, *entry;
+    InvertedPageTable *index;
+    int numEntries, lookups, i, k;
+    clock_t start;
+    double hashed, linear;
+
+    for (int s = 0; s < 3; s++) {
+	numEntries = sizes[s];
+	table = new TranslationEntry[numEntries];
+	index = new InvertedPageTable(table, numEntries);
+	for (i = 0; i < numEntries; i++) {
+	    table[i].tid = i % 8;
+	    table[i].virtualPage = i / 8;
+	    table[i].physicalPage = i;
+	    table[i].valid = TRUE;
+	    index->Insert(&table[i]);
+	}
+
+	lookups = work / numEntries * 64;
+	start = clock();
+	for (i = 0; i < lookups; i++) {
+	    k = Random() % numEntries;
+	    entry = index->Lookup(k % 8, k / 8);
+	    ASSERT(entry == &table[k]);
+	}
+	hashed = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / lookups;
+
+	lookups = work / numEntries;
+	start = clock();
+	for (i = 0; i < lookups; i++) {
+	    k = Random() % numEntries;
+	    entry = LinearLookup(table, numEntries, k % 8, k / 8);
+	    ASSERT(entry == &table[k]);
+	}
+	linear = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / lookups;
+
+	printf("%6d frames: hashed lookup %8.1f ns, linear scan %10.1f ns\n",
+		numEntries, hashed, linear);
+	delete index;
+	delete [] table;
+    }
+}
+
+//----------------------------------------------------------------------
+// ScanFind, ScanNumClear
+// 	Find and NumClear the way the bitmap used to do them, a bit at a
+//	time, to compare against.
+//----------------------------------------------------------------------
+
+static int
+ScanFind(BitMap *map, int numBits)
+{
+    for (int i = 0; i < numBits; i++)
+	if (!map->Test(i)) {
+	    map->Mark(i);
+	    return i;
+	}
+    return -1;
+}
+
+static int
+ScanNumClear(BitMap *map, int numBits)
+{
+    int count = 0;
+
+    for (int i = 0; i < numBits; i++)
+	if (!map->Test(i)) count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// BitMapTest
+// 	Measure how long Find and NumClear take on bitmaps of 4K, 64K
+//	and 1M bits, against a scan a bit at a time.  Each map starts
+//	with one bit in 64 clear, at random; then, over and over, a
+//	random bit is freed and the first clear bit allocated, so the
+//	free bits drift towards the end of the map as it fragments.
+//----------------------------------------------------------------------
+
+void
+BitMapTest()
+{
+    static int sizes[] = { 4096, 65536, 1 << 20 };
+    const int work = 1 << 26;		// bits the scans may look at
+    BitMap *map;
+    int *freed;
+    int numBits, rounds, counts, i;
+    unsigned int found, scanned;		// sums of the bits allocated
+    clock_t start;
+    double find, scanFind, numClear, scanNumClear;
+
+    for (int s = 0; s < 3; s++) {
+	numBits = sizes[s];
+	rounds = 4096;
+	counts = work / numBits;
+	freed = new int[rounds];
+	for (i = 0; i < rounds; i++)
+	    freed[i] = Random() % numBits;
+
+	RandomInit(numBits);
+	map = new BitMap(numBits);
+	for (i = 0; i < numBits; i++)
+	    if (Random() % 64 != 0)
+		map->Mark(i);
+	start = clock();
+	found = 0;
+	for (i = 0; i < rounds; i++) {
+	    map->Clear(freed[i]);
+	    found += map->Find();
+	}
+	find = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds;
+	start = clock();
+	for (i = 0; i < counts; i++)
+	    map->NumClear();
+	numClear = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / counts;
+	delete map;
+
+	RandomInit(numBits);
+	map = new BitMap(numBits);
+	for (i = 0; i < numBits; i++)
+	    if (Random() % 64 != 0)
+		map->Mark(i);
+	start = clock();
+	scanned = 0;
+	for (i = 0; i < rounds; i++) {
+	    map->Clear(freed[i]);
+	    scanned += ScanFind(map, numBits);
+	}
+	scanFind = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds;
+	ASSERT(found == scanned);
+	start = clock();
+	for (i = 0; i < counts; i++)
+	    ScanNumClear(map, numBits);
+	scanNumClear = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9
+								/ counts;
+	ASSERT(map->NumClear() == ScanNumClear(map, numBits));
+	delete map;
+	delete [] freed;
+
+	printf("%7d bits: Find %8.1f ns, scan %10.1f ns; "
+		"NumClear %9.1f ns, scan %11.1f ns\n",
+		numBits, find, scanFind, numClear, scanNumClear);
+    }
+}
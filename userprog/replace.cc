@@ -0,0 +1,117 @@
+// replace.cc 
+//	Routines to choose a page frame to reuse on a page fault.
+//	See replace.h for the policies.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "replace.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// LRUPolicy::SelectVictim
+// 	Return the frame whose page was referenced longest ago.  The
+//	machine stamps a frame with the current time whenever a page in
+//	it is translated.  Frames that are free (see the page daemon) are
+//	passed over, and so are those of other address spaces, if the
+//	victim must be one of "space"'s.
+//----------------------------------------------------------------------
+
+int
+LRUPolicy::SelectVictim(AddrSpace *space)
+{
+    int oldest = -1;
+
+    for (int i = 0; i < NumPhysPages; i++)
+	if (memBitMap->Test(i)
+		&& ((space == NULL) || (coreMap[i].space == space))
+		&& ((oldest < 0)
+		|| (machine->pageLasttime[i] < machine->pageLasttime[oldest])))
+	    oldest = i;
+    return oldest;
+}
+
+//----------------------------------------------------------------------
+// LRUPolicy::ColdVictim
+// 	Return the frame whose page was referenced longest ago, if that
+//	was before "since".
+//----------------------------------------------------------------------
+
+int
+LRUPolicy::ColdVictim(int since)
+{
+    int oldest = SelectVictim();
+
+    if ((oldest < 0) || (machine->pageLasttime[oldest] >= since))
+	return -1;
+    return oldest;
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::ClockPolicy
+// 	Start the clock hand at the first page frame.
+//----------------------------------------------------------------------
+
+ClockPolicy::ClockPolicy()
+{
+    hand = 0;
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::SelectVictim
+// 	Advance the hand to the first frame whose use bit is clear,
+//	clearing the use bits it passes over, and return that frame.
+//	At most one full sweep is needed, so the cost is constant when
+//	amortized over the references that set the bits.
+//
+//	The machine keeps translations cached where Translate does not
+//	see them, so a cleared page's translations are dropped; that way
+//	the next reference goes through Translate and sets the bit again.
+//	A page that nobody has mapped is taken at once; a frame that is
+//	free is passed over.  If the victim must be one of "space"'s, the
+//	hand passes over other address spaces' frames without touching
+//	their use bits.
+//----------------------------------------------------------------------
+
+int
+ClockPolicy::SelectVictim(AddrSpace *space)
+{
+    TranslationEntry *entry;
+    int frame;
+
+    for (;;) {
+	frame = hand;
+	hand = (hand + 1) % NumPhysPages;
+	if (!memBitMap->Test(frame)
+		|| ((space != NULL) && (coreMap[frame].space != space)))
+	    continue;
+	entry = coreMap[frame].entry;
+	if ((entry == NULL) || !entry->use)
+	    return frame;
+	entry->use = FALSE;		// second chance
+	coreMap[frame].page->prefetched = FALSE;	// it was used
+	machine->InvalidateTranslation(entry->tid, entry->virtualPage);
+    }
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::ColdVictim
+// 	Return the frame under the hand, and advance the hand, if its use
+//	bit is clear; that is, if it has not been used since the hand last
+//	passed it, whenever that was.  Unlike SelectVictim, this never
+//	sweeps, so it clears no use bits.
+//----------------------------------------------------------------------
+
+int
+ClockPolicy::ColdVictim(int since)
+{
+    int frame = hand;
+    TranslationEntry *entry = coreMap[frame].entry;
+
+    if ((entry != NULL) && entry->use)
+	return -1;
+    hand = (hand + 1) % NumPhysPages;
+    return frame;
+}
@@ -0,0 +1,64 @@
+// replace.h 
+//	Data structures for choosing which page to throw out of physical
+//	memory when a page fault finds every page frame in use.
+//
+//	A replacement policy only picks the victim; Machine::LRU (in
+//	exception.cc) does the paging.  coreMap[i].entry is the
+//	translation for page frame i, or NULL if its page is not mapped.
+//
+//	Two policies are provided: LRU, which evicts the page whose last
+//	reference (machine->pageLasttime) is oldest, and clock, which
+//	gives each page a second chance if its use bit is set.  Clock
+//	spares the machine stamping every reference with the time,
+//	unless something else (see Initialize) wants the stamps.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class AddrSpace;
+
+// The interface every page replacement policy provides.
+
+class ReplacementPolicy {
+  public:
+    virtual ~ReplacementPolicy() {}
+
+    virtual int SelectVictim(AddrSpace *space = NULL) = 0;
+					// return the page frame to reuse,
+					// one "space" has mapped if it is
+					// not NULL; there must be one
+    virtual int ColdVictim(int since) = 0;
+					// return a frame not referenced
+					// since time "since", if one is
+					// easy to find, otherwise -1
+};
+
+// Least recently used: scan every frame for the oldest reference time.
+
+class LRUPolicy : public ReplacementPolicy {
+  public:
+    int SelectVictim(AddrSpace *space = NULL);
+    int ColdVictim(int since);
+};
+
+// Second chance: sweep a hand around the frames, clearing use bits,
+// until it comes to a frame that has not been used since the last sweep.
+
+class ClockPolicy : public ReplacementPolicy {
+  public:
+    ClockPolicy();
+    int SelectVictim(AddrSpace *space = NULL);
+    int ColdVictim(int since);
+
+  private:
+    int hand;				// next frame to look at
+};
+
+#endif // REPLACE_H
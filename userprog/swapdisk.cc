@@ -0,0 +1,442 @@
+// swapdisk.cc
+//	Routines to manage the swap device.  Slot i of the swap disk is
+//	sectors i * sectorsPerPage up to (i + 1) * sectorsPerPage - 1; with
+//	the default page size a page is one sector, and is read or written
+//	with one disk request.
+//
+//	As in SynchDisk, a semaphore synchronizes the requesting thread
+//	with the disk interrupt, and a lock keeps more than one request
+//	from being sent to the disk at a time.
+//
+//	With a compressed pool, a page written to swap is compressed and
+//	kept in memory.  Pages are compressed a word at a time: a word
+//	that is zero, repeats the word before it, or is one of a few
+//	recently seen words, takes a couple of bits, and any other word
+//	takes the bits plus itself.  A page that is one word over and
+//	over, as an untouched or cleared page is, is kept as just that
+//	word.  A page that does not get smaller goes straight to the disk,
+//	and when the pool is full the page compressed longest ago is
+//	written out to make room.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swapdisk.h"
+#include "synch.h"
+#include "list.h"
+
+#include <strings.h>
+
+#define DictSize	16	// recently seen words a compressed page
+				// can refer to by number
+
+// How each word of a compressed page is stored; the tags, two bits
+// per word, come first, followed by what the words need besides.
+enum WordTag { WordZero, WordRepeat, WordInDict, WordLiteral };
+
+//----------------------------------------------------------------------
+// DictIndex
+// 	Where a word goes in the dictionary of recently seen words.
+//----------------------------------------------------------------------
+
+static int
+DictIndex(int word)
+{
+    return ((unsigned) word * 2654435761u) >> 28;
+}
+
+//----------------------------------------------------------------------
+// CompressPage
+// 	Compress a page, and return how many bytes it takes; PageSize if
+//	it would not get any smaller.
+//
+//	"page" -- the page to compress
+//	"into" -- where to put the result; PageSize bytes
+//----------------------------------------------------------------------
+
+static int
+CompressPage(char *page, char *into)
+{
+    int words = PageSize / sizeof(int);
+    int tagBytes = (words + 3) / 4;
+    int dict[DictSize];
+    int i, word, first, previous = 0, tag, index;
+    int size = tagBytes;
+
+    bcopy(page, (char *) &first, sizeof(int));
+    for (i = 1; i < words; i++) {
+	bcopy(&page[i * sizeof(int)], (char *) &word, sizeof(int));
+	if (word != first)
+	    break;
+    }
+    if (i == words) {			// the same word all the way through
+	bcopy((char *) &first, into, sizeof(int));
+	return sizeof(int);
+    }
+
+    bzero(into, tagBytes);
+    bzero((char *) dict, sizeof(dict));
+    for (i = 0; i < words; i++) {
+	if (size + (int) sizeof(int) > PageSize)
+	    return PageSize;		// not worth it
+	bcopy(&page[i * sizeof(int)], (char *) &word, sizeof(int));
+	index = DictIndex(word);
+	if (word == 0)
+	    tag = WordZero;
+	else if (word == previous)
+	    tag = WordRepeat;
+	else if (dict[index] == word) {
+	    tag = WordInDict;
+	    into[size++] = index;
+	} else {
+	    tag = WordLiteral;
+	    bcopy((char *) &word, &into[size], sizeof(int));
+	    size += sizeof(int);
+	    dict[index] = word;
+	}
+	into[i / 4] |= tag << ((i % 4) * 2);
+	previous = word;
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------
+// DecompressPage
+// 	Undo CompressPage.
+//
+//	"from" -- the compressed page
+//	"size" -- how many bytes it takes
+//	"page" -- where to put the page
+//----------------------------------------------------------------------
+
+static void
+DecompressPage(char *from, int size, char *page)
+{
+    int words = PageSize / sizeof(int);
+    int dict[DictSize];
+    int i, word, previous = 0;
+    char *next = &from[(words + 3) / 4];
+
+    if (size == sizeof(int)) {
+	for (i = 0; i < words; i++)
+	    bcopy(from, &page[i * sizeof(int)], sizeof(int));
+	return;
+    }
+    bzero((char *) dict, sizeof(dict));
+    for (i = 0; i < words; i++) {
+	switch ((from[i / 4] >> ((i % 4) * 2)) & 3) {
+	  case WordZero:
+	    word = 0;
+	    break;
+	  case WordRepeat:
+	    word = previous;
+	    break;
+	  case WordInDict:
+	    word = dict[(unsigned char) *next++];
+	    break;
+	  case WordLiteral:
+	    bcopy(next, (char *) &word, sizeof(int));
+	    next += sizeof(int);
+	    dict[DictIndex(word)] = word;
+	    break;
+	}
+	bcopy((char *) &word, &page[i * sizeof(int)], sizeof(int));
+	previous = word;
+    }
+    ASSERT(next == from + size);
+}
+
+//----------------------------------------------------------------------
+// SwapRequestDone
+// 	Swap disk interrupt handler.  Need this to be a C routine, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+SwapRequestDone(int arg)
+{
+    SwapDisk *swap = (SwapDisk *) arg;
+
+    swap->RequestDone();
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::SwapDisk
+// 	Initialize the swap device, and the raw disk under it.  All the
+//	slots are free; whatever the disk held is garbage.
+//
+//	"name" -- UNIX file name to be used as storage for the disk data
+//	"poolBytes" -- how much memory compressed pages may take; 0 to
+//		write every page to the disk
+//----------------------------------------------------------------------
+
+SwapDisk::SwapDisk(char *name, int poolBytes)
+{
+    sectorsPerPage = PageSize / SectorSize;
+    numSlots = NumSectors / sectorsPerPage;
+    slots = new BitMap(numSlots);
+    cache = new CachedPage *[numSlots];
+    for (int i = 0; i < numSlots; i++)
+	cache[i] = NULL;
+    cacheOrder = new List;
+    poolSize = poolBytes;
+    poolUsed = 0;
+    semaphore = new Semaphore("swap disk", 0);
+    lock = new Lock("swap disk lock");
+    disk = new Disk(name, SwapRequestDone, (int) this);
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::~SwapDisk
+// 	De-allocate the swap device.
+//----------------------------------------------------------------------
+
+SwapDisk::~SwapDisk()
+{
+    for (int i = 0; i < numSlots; i++)
+	Uncache(i);
+    delete [] cache;
+    delete cacheOrder;
+    delete disk;
+    delete lock;
+    delete semaphore;
+    delete slots;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Allocate
+// 	Take a free slot and return it, or -1 if the swap disk is full.
+//
+//	"near" -- the slot wanted, if it is free, so that pages can be
+//		placed for reading back together; -1 if any will do
+//----------------------------------------------------------------------
+
+int
+SwapDisk::Allocate(int near)
+{
+    if ((near >= 0) && (near < numSlots) && !slots->Test(near)) {
+	slots->Mark(near);
+	return near;
+    }
+    return slots->Find();
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Free
+// 	Give a slot back, and the memory its compressed page takes.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Free(int slot)
+{
+    ASSERT(slots->Test(slot));
+    Uncache(slot);
+    slots->Clear(slot);
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::ReadPages
+// 	Read the contents of consecutive slots into memory.  Return only
+//	after the data has been read.  Pages in the compressed pool are
+//	uncompressed; the rest are read from the disk, where their
+//	sectors are consecutive too, so after the first the disk's track
+//	buffer usually has them.
+//
+//	"slot" -- the first slot
+//	"count" -- how many to read
+//	"into" -- where to put them, "count" pages in a row
+//----------------------------------------------------------------------
+
+void
+SwapDisk::ReadPages(int slot, int count, char *into)
+{
+    CachedPage *cached;
+
+    ASSERT((slot >= 0) && (slot + count <= numSlots));
+    lock->Acquire();			// only one disk I/O at a time
+    for (int i = 0; i < count; i++) {
+	cached = cache[slot + i];
+	if (cached != NULL) {
+	    DecompressPage(cached->data, cached->size, &into[i * PageSize]);
+	    stats->numSwapCacheHits++;
+	} else
+	    ReadSectors(slot + i, &into[i * PageSize]);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::WritePage
+// 	Write a page to a slot: into the compressed pool if it fits, or
+//	else to the disk.  Return only after the data has been written.
+//
+//	"slot" -- the slot, which must have been allocated
+//	"from" -- the page's contents
+//----------------------------------------------------------------------
+
+void
+SwapDisk::WritePage(int slot, char *from)
+{
+    WritePages(slot, 1, from);
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::WritePages
+// 	Write pages to consecutive slots, as WritePage does each one.
+//	Those that go to the disk are written in one pass, in order, so
+//	each starts where the one before it left the disk head.
+//
+//	"slot" -- the first slot; all of them must have been allocated
+//	"count" -- how many to write
+//	"from" -- their contents, "count" pages in a row
+//----------------------------------------------------------------------
+
+void
+SwapDisk::WritePages(int slot, int count, char *from)
+{
+    ASSERT((slot >= 0) && (slot + count <= numSlots));
+    lock->Acquire();			// only one disk I/O at a time
+    for (int i = 0; i < count; i++) {
+	ASSERT(slots->Test(slot + i));
+	Uncache(slot + i);		// whatever it held is out of date
+	if (!CachePage(slot + i, &from[i * PageSize]))
+	    WriteSectors(slot + i, &from[i * PageSize]);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::ReadSectors, SwapDisk::WriteSectors
+// 	Move one page between memory and its slot on the disk, one sector
+//	request at a time.  The caller holds the lock.
+//
+//	"slot" -- the slot
+//	"into", "from" -- the page's contents
+//----------------------------------------------------------------------
+
+void
+SwapDisk::ReadSectors(int slot, char *into)
+{
+    int first = slot * sectorsPerPage;
+
+    for (int i = 0; i < sectorsPerPage; i++) {
+	disk->ReadRequest(first + i, &into[i * SectorSize]);
+	semaphore->P();			// wait for interrupt
+    }
+}
+
+void
+SwapDisk::WriteSectors(int slot, char *from)
+{
+    int first = slot * sectorsPerPage;
+
+    for (int i = 0; i < sectorsPerPage; i++) {
+	disk->WriteRequest(first + i, &from[i * SectorSize]);
+	semaphore->P();			// wait for interrupt
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::CachePage
+// 	Compress a page into the pool, writing older pages out to the
+//	disk if that is what it takes to make room.  Return FALSE, and
+//	leave the page for the disk, if there is no pool or the page does
+//	not compress.  The caller holds the lock.
+//
+//	"slot" -- the page's slot
+//	"from" -- the page's contents
+//----------------------------------------------------------------------
+
+bool
+SwapDisk::CachePage(int slot, char *from)
+{
+    char *buffer;
+    CachedPage *cached;
+    int size;
+
+    if (poolSize == 0)
+	return FALSE;
+    buffer = new char[PageSize];
+    size = CompressPage(from, buffer);
+    if ((size >= PageSize) || (size > poolSize)) {
+	delete [] buffer;
+	stats->numSwapCacheRejects++;
+	return FALSE;
+    }
+    while (poolUsed + size > poolSize)
+	Spill();
+
+    cached = new CachedPage;
+    cached->slot = slot;
+    cached->size = size;
+    cached->data = new char[size];
+    bcopy(buffer, cached->data, size);
+    delete [] buffer;
+    cache[slot] = cached;
+    cacheOrder->Append((void *) cached);
+    poolUsed += size;
+
+    stats->numSwapCacheStores++;
+    if (size == sizeof(int))
+	stats->numSameValuePages++;
+    stats->swapCacheBytesIn += PageSize;
+    stats->swapCacheBytesOut += size;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Uncache
+// 	Throw away a slot's compressed page, if it has one.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Uncache(int slot)
+{
+    CachedPage *cached = cache[slot];
+
+    if (cached == NULL)
+	return;
+    cacheOrder->Remove((void *) cached);
+    cache[slot] = NULL;
+    poolUsed -= cached->size;
+    delete [] cached->data;
+    delete cached;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Spill
+// 	Make room in the pool, by writing the page that was compressed
+//	longest ago to its slot on the disk.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Spill()
+{
+    CachedPage *oldest = (CachedPage *) cacheOrder->Remove();
+    char *page = new char[PageSize];
+
+    ASSERT(oldest != NULL);
+    DecompressPage(oldest->data, oldest->size, page);
+    cache[oldest->slot] = NULL;
+    poolUsed -= oldest->size;
+    WriteSectors(oldest->slot, page);
+    delete [] page;
+    delete [] oldest->data;
+    delete oldest;
+    stats->numSwapCacheSpills++;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::RequestDone
+// 	Swap disk interrupt handler.  Wake up the thread waiting for the
+//	request to finish.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::RequestDone()
+{
+    semaphore->V();
+}
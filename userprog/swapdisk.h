@@ -0,0 +1,91 @@
+// swapdisk.h
+//	Data structures for the swap device: a simulated disk of its own,
+//	holding the pages that have been thrown out of memory.
+//
+//	The disk is divided into slots of one page each, which are handed
+//	out one page at a time and kept track of with a bitmap.  Swapping
+//	goes straight to the sectors of a slot, so it costs no file
+//	system lookups, and it does not compete with the file system for
+//	the disk head.
+//
+//	Optionally, pages written to swap are first compressed into a
+//	bounded pool of memory, and only go to the disk when the pool
+//	fills up; a page read back from the pool costs no disk I/O at all.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPDISK_H
+#define SWAPDISK_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "bitmap.h"
+
+class Semaphore;
+class Lock;
+class List;
+
+// A swapped-out page held compressed in memory, instead of on the disk.
+
+class CachedPage {
+  public:
+    int slot;				// the swap slot it stands for
+    int size;				// bytes in "data"
+    char *data;				// the compressed contents
+};
+
+// The following class defines the swap device.  Like a SynchDisk, it
+// lets a thread read or write and wait until the disk is done, while
+// other threads run.
+
+class SwapDisk {
+  public:
+    SwapDisk(char *name, int poolBytes);
+					// Initialize the swap device, by
+					// initializing a raw Disk stored in
+					// the UNIX file "name"; compressed
+					// pages may use up to "poolBytes"
+    ~SwapDisk();			// De-allocate the swap device
+
+    int Allocate(int near);		// Take a free slot, "near" if it is
+					// free; -1 if there is none
+    void Free(int slot);		// Give a slot back
+
+    void ReadPages(int slot, int count, char *into);
+					// Read "count" pages, from
+					// consecutive slots, into memory
+    void WritePage(int slot, char *from);
+					// Write one page to a slot
+    void WritePages(int slot, int count, char *from);
+					// Write "count" pages, to
+					// consecutive slots, from memory
+
+    void RequestDone();			// Called by the disk interrupt
+					// handler when a request is done
+
+  private:
+    Disk *disk;				// Raw disk device
+    Semaphore *semaphore;		// To wait for the disk interrupt
+    Lock *lock;				// Only one request at a time
+    BitMap *slots;			// Which slots are in use
+    int numSlots;			// How many pages the disk holds
+    int sectorsPerPage;			// Sectors in a slot
+
+    CachedPage **cache;			// For each slot, its compressed
+					// page, or NULL if it is on disk
+    List *cacheOrder;			// Compressed pages, oldest first
+    int poolSize;			// Most bytes they may take
+    int poolUsed;			// Bytes they take now
+
+    void ReadSectors(int slot, char *into);	// Move one page to or
+    void WriteSectors(int slot, char *from);	// from the disk
+    bool CachePage(int slot, char *from);	// Compress a page into
+						// the pool, if it fits
+    void Uncache(int slot);		// Drop a slot's compressed page
+    void Spill();			// Write the oldest compressed page
+					// to the disk, to make room
+};
+
+#endif // SWAPDISK_H